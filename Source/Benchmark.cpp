@@ -0,0 +1,528 @@
+#include <SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include <Engine.h>
+#include <Objects.h>
+#include <Random.h>
+#include <Rasterizer.h>
+#include <RenderTarget.h>
+#include <Texture.h>
+#include <Types.h>
+#include <VertexProcessor.h>
+
+// Every scene is generated from this seed, so that runs on different
+// machines and releases measure the same work
+constexpr static uint32_t SEED = Random::DEFAULT_SEED;
+
+// Screen resolutions at which rasterization and drawing are measured
+constexpr static int RESOLUTIONS[][2] = {
+	{ 640, 360 },
+	{ 1280, 720 },
+	{ 1920, 1080 }
+};
+
+/**
+ * Distributions of triangle sizes, given as a range of bounding box
+ * edge lengths in pixels.
+ */
+struct TriangleDistribution {
+	int minSize;
+	int maxSize;
+};
+
+constexpr static TriangleDistribution TRIANGLE_DISTRIBUTIONS[] = {
+	{ 2, 8 },
+	{ 16, 64 },
+	{ 128, 512 }
+};
+
+// Values written here keep the compiler from discarding the results
+// of benchmarked work
+volatile float sink;
+
+typedef std::vector<std::pair<const char*, double>> Parameters;
+
+/**
+ * Timings of a single benchmark. Items are the units of work done per
+ * iteration, e.g. triangles or vertices, used to report a per-item time.
+ */
+struct BenchmarkResult {
+	std::string name;
+	Parameters parameters;
+	int items;
+	int iterations;
+	double meanTime;
+	double medianTime;
+	double minTime;
+	double maxTime;
+};
+
+/**
+ * Runs benchmarks, collecting their results. Each benchmark is run
+ * once to warm up, then timed over at least MIN_ITERATIONS iterations
+ * and until the suite's minimum time has elapsed.
+ */
+class BenchmarkSuite {
+	public:
+		BenchmarkSuite(const char* filter, double minTime);
+		void run(const std::string& name, const Parameters& parameters, int items, const std::function<void()>& body);
+		bool writeJSON(FILE* file, const char* configuration);
+	private:
+		constexpr static int MIN_ITERATIONS = 5;
+		constexpr static int MAX_ITERATIONS = 100000;
+		const char* filter;
+		double minTime;
+		std::vector<BenchmarkResult> results;
+};
+
+BenchmarkSuite::BenchmarkSuite(const char* filter, double minTime) {
+	this->filter = filter;
+	this->minTime = minTime;
+}
+
+void BenchmarkSuite::run(const std::string& name, const Parameters& parameters, int items, const std::function<void()>& body) {
+	if (filter != NULL && name.find(filter) == std::string::npos) {
+		return;
+	}
+
+	Uint64 frequency = SDL_GetPerformanceFrequency();
+	std::vector<double> times;
+	double totalTime = 0.0;
+
+	body();
+
+	while (times.size() < MAX_ITERATIONS && (times.size() < MIN_ITERATIONS || totalTime < minTime)) {
+		Uint64 startTime = SDL_GetPerformanceCounter();
+
+		body();
+
+		double time = 1000.0 * (SDL_GetPerformanceCounter() - startTime) / frequency;
+
+		times.push_back(time);
+		totalTime += time;
+	}
+
+	std::sort(times.begin(), times.end());
+
+	BenchmarkResult result;
+
+	result.name = name;
+	result.parameters = parameters;
+	result.items = items;
+	result.iterations = times.size();
+	result.meanTime = totalTime / times.size();
+	result.medianTime = times.at(times.size() / 2);
+	result.minTime = times.front();
+	result.maxTime = times.back();
+
+	results.push_back(result);
+
+	fprintf(stderr, "%-28s", name.c_str());
+
+	for (const auto& parameter : parameters) {
+		fprintf(stderr, " %s=%g", parameter.first, parameter.second);
+	}
+
+	fprintf(stderr, "  median %.4fms, %.2fns/item\n", result.medianTime, 1.0e6 * result.medianTime / items);
+}
+
+/**
+ * Writes every result as a JSON document. Times are in milliseconds
+ * per iteration, except ns_per_item, which divides the median time
+ * between the items of an iteration.
+ */
+bool BenchmarkSuite::writeJSON(FILE* file, const char* configuration) {
+	fprintf(file, "{\n");
+	fprintf(file, "  \"version\": 1,\n");
+	fprintf(file, "  \"configuration\": {%s},\n", configuration);
+	fprintf(file, "  \"benchmarks\": [\n");
+
+	for (int i = 0; i < results.size(); i++) {
+		const BenchmarkResult& result = results.at(i);
+
+		fprintf(file, "    {\"name\": \"%s\", \"parameters\": {", result.name.c_str());
+
+		for (int p = 0; p < result.parameters.size(); p++) {
+			fprintf(file, "%s\"%s\": %g", p > 0 ? ", " : "", result.parameters.at(p).first, result.parameters.at(p).second);
+		}
+
+		fprintf(
+			file,
+			"}, \"items\": %d, \"iterations\": %d, \"mean_ms\": %.6f, \"median_ms\": %.6f, \"min_ms\": %.6f, \"max_ms\": %.6f, \"ns_per_item\": %.3f}%s\n",
+			result.items, result.iterations, result.meanTime, result.medianTime, result.minTime, result.maxTime,
+			1.0e6 * result.medianTime / result.items, i < results.size() - 1 ? "," : ""
+		);
+	}
+
+	fprintf(file, "  ]\n}\n");
+
+	return ferror(file) == 0;
+}
+
+/**
+ * Reaches into the rasterizer for the stages below its public API.
+ */
+class RasterizerBenchmark {
+	public:
+		/**
+		 * Draws a scanline, first preparing the tiles it covers as
+		 * triangles do, so that render() clears them again.
+		 */
+		static void scanLine(Rasterizer& rasterizer, int x, int y, int length, const Color& leftColor, const Color& rightColor, int leftDepth, int rightDepth) {
+			rasterizer.prepareTiles({ x, y, std::min(x + length + 1, rasterizer.width), y + 1 });
+			rasterizer.triangleScanLine(x, y, length, leftColor, rightColor, leftDepth, rightDepth, { 0, 0, rasterizer.width, rasterizer.height });
+		}
+};
+
+Color randomColor() {
+	return { Random::nextInt(255), Random::nextInt(255), Random::nextInt(255) };
+}
+
+void benchmarkTransforms(BenchmarkSuite& suite) {
+	constexpr static int COUNT = 100000;
+	std::vector<Vec3> rotations;
+	std::vector<RotationMatrix> matrices;
+	std::vector<Vec3> vectors;
+
+	Random::seed(SEED);
+
+	for (int i = 0; i < COUNT; i++) {
+		Vec3 rotation = { Random::nextFloat(-3.0f, 3.0f), Random::nextFloat(-3.0f, 3.0f), Random::nextFloat(-3.0f, 3.0f) };
+
+		rotations.push_back(rotation);
+		matrices.push_back(RotationMatrix::calculate(rotation));
+		vectors.push_back({ Random::nextFloat(-100.0f, 100.0f), Random::nextFloat(-100.0f, 100.0f), Random::nextFloat(-100.0f, 100.0f) });
+	}
+
+	suite.run("transform/rotation_calculate", {}, COUNT, [&]() {
+		float total = 0.0f;
+
+		for (int i = 0; i < COUNT; i++) {
+			total += RotationMatrix::calculate(rotations[i]).m11;
+		}
+
+		sink = total;
+	});
+
+	suite.run("transform/rotation_multiply", {}, COUNT, [&]() {
+		RotationMatrix product = matrices[0];
+
+		for (int i = 1; i < COUNT; i++) {
+			product = matrices[i] * product;
+		}
+
+		sink = product.m11;
+	});
+
+	suite.run("transform/rotation_vector", {}, COUNT, [&]() {
+		float total = 0.0f;
+
+		for (int i = 0; i < COUNT; i++) {
+			total += (matrices[i] * vectors[i]).x;
+		}
+
+		sink = total;
+	});
+
+	suite.run("transform/matrix4_multiply", {}, COUNT, [&]() {
+		Matrix4 product = Matrix4::createTransform(matrices[0], vectors[0]);
+
+		for (int i = 1; i < COUNT; i++) {
+			product = Matrix4::createTransform(matrices[i], vectors[i]) * product;
+		}
+
+		sink = product.m11;
+	});
+}
+
+void benchmarkProjection(BenchmarkSuite& suite) {
+	constexpr static VertexKernel KERNELS[] = { SCALAR_KERNEL, SSE_KERNEL, AVX2_KERNEL };
+	constexpr static const char* KERNEL_NAMES[] = { "scalar", "sse", "avx2" };
+	constexpr static int COUNT = 100000;
+	VertexStream input;
+	VertexStream output;
+	ProjectionParameters parameters;
+
+	Random::seed(SEED);
+
+	for (int i = 0; i < COUNT; i++) {
+		input.push({ Random::nextFloat(-1000.0f, 1000.0f), Random::nextFloat(-1000.0f, 1000.0f), Random::nextFloat(-100.0f, 5000.0f) });
+	}
+
+	parameters.transform = Matrix4::createPerspective(640.0f, 640.0f, 360.0f, 1.0f, 100000.0f);
+
+	for (int k = 0; k < 3; k++) {
+		VertexProcessor vertexProcessor;
+
+		if (!vertexProcessor.setKernel(KERNELS[k])) {
+			continue;
+		}
+
+		suite.run(std::string("project/") + KERNEL_NAMES[k], { { "vertices", COUNT } }, COUNT, [&]() {
+			vertexProcessor.project(parameters, input.getSpan(), COUNT, output);
+
+			sink = output.z[COUNT - 1];
+		});
+	}
+}
+
+void benchmarkScanLines(BenchmarkSuite& suite, DepthFormat depthFormat) {
+	constexpr static int LENGTHS[] = { 16, 128, 1024 };
+	constexpr static int COUNT = 1000;
+
+	for (const auto& resolution : RESOLUTIONS) {
+		int width = resolution[0];
+		int height = resolution[1];
+
+		for (int length : LENGTHS) {
+			// Each length starts from cleared buffers, rather than
+			// testing against the depths left by the last
+			FramebufferTarget target(width, height);
+			Rasterizer rasterizer(&target, width, height);
+			std::vector<Coordinate> starts;
+			int depth = 1 << DEPTH_BITS;
+
+			rasterizer.setDepthFormat(depthFormat);
+			Random::seed(SEED);
+
+			for (int i = 0; i < COUNT; i++) {
+				starts.push_back({ Random::nextInt(std::max(width - length, 1)), Random::nextInt(height) });
+			}
+
+			suite.run("raster/scanline", { { "length", length }, { "width", width }, { "height", height } }, COUNT, [&]() {
+				// Each pass draws nearer than the last, so that every
+				// pixel passes the depth test
+				depth -= 1 << (DEPTH_BITS - 16);
+
+				if (depth <= 0) {
+					rasterizer.render();
+					depth = 1 << DEPTH_BITS;
+				}
+
+				for (int i = 0; i < COUNT; i++) {
+					RasterizerBenchmark::scanLine(rasterizer, starts[i].x, starts[i].y, length, { 255, 0, 0 }, { 0, 0, 255 }, depth, depth);
+				}
+			});
+		}
+	}
+}
+
+void benchmarkTriangles(BenchmarkSuite& suite, TriangleTraversal traversal, DepthFormat depthFormat) {
+	constexpr static int COUNT = 1000;
+	std::string name = traversal == HALF_SPACE_TRAVERSAL ? "raster/triangle_half_space" : "raster/triangle_scanline";
+
+	// Each specialized pipeline is measured separately, suffixing the
+	// benchmark's name, with Gouraud shading as the unsuffixed default
+	RasterState gouraud;
+	RasterState flat;
+	RasterState depthOnly;
+	RasterState textured;
+
+	flat.shading = SHADE_FLAT;
+	depthOnly.shading = SHADE_NONE;
+	textured.shading = SHADE_TEXTURED;
+
+	const std::pair<const char*, RasterState> pipelines[] = {
+		{ "", gouraud },
+		{ "_flat", flat },
+		{ "_depth_only", depthOnly },
+		{ "_textured", textured }
+	};
+
+	// Textured triangles repeat a 64x64 texel checkerboard every 64
+	// pixels, so that every triangle samples its largest level
+	std::shared_ptr<const Texture> checkerboard = Texture::createCheckerboard(64, 8, { 240, 240, 240 }, { 40, 90, 160 });
+
+	for (const auto& resolution : RESOLUTIONS) {
+		int width = resolution[0];
+		int height = resolution[1];
+		FramebufferTarget target(width, height);
+		Rasterizer rasterizer(&target, width, height);
+
+		rasterizer.setTraversal(traversal);
+		rasterizer.setDepthFormat(depthFormat);
+
+		for (const TriangleDistribution& distribution : TRIANGLE_DISTRIBUTIONS) {
+			std::vector<Triangle> triangles(COUNT);
+			std::vector<Triangle> texturedTriangles;
+
+			Random::seed(SEED);
+
+			for (Triangle& triangle : triangles) {
+				float size = Random::nextFloat(distribution.minSize, distribution.maxSize);
+				float x = Random::nextFloat(0.0f, width - size);
+				float y = Random::nextFloat(0.0f, height - size);
+
+				for (int v = 0; v < 3; v++) {
+					triangle.createVertex(v, x + Random::nextFloat(0.0f, size), y + Random::nextFloat(0.0f, size), Random::nextInt(1 << DEPTH_BITS), randomColor());
+				}
+			}
+
+			texturedTriangles = triangles;
+
+			for (Triangle& triangle : texturedTriangles) {
+				triangle.texture = checkerboard.get();
+
+				for (Vertex2d& vertex : triangle.vertices) {
+					vertex.uv = { vertex.coordinate.x / 64.0f, vertex.coordinate.y / 64.0f };
+				}
+			}
+
+			// Triangles are drawn and presented as a whole frame, so
+			// that depth tests see the same buffer contents each time
+			for (const auto& pipeline : pipelines) {
+				std::vector<Triangle>& drawn = pipeline.second.shading == SHADE_TEXTURED ? texturedTriangles : triangles;
+
+				rasterizer.setState(pipeline.second);
+
+				suite.run(name + pipeline.first, { { "min_size", distribution.minSize }, { "max_size", distribution.maxSize }, { "width", width }, { "height", height } }, COUNT, [&]() {
+					for (Triangle& triangle : drawn) {
+						rasterizer.triangle(triangle);
+					}
+
+					rasterizer.render();
+				});
+			}
+		}
+	}
+}
+
+void benchmarkDraw(BenchmarkSuite& suite, Uint32 flags) {
+	constexpr static int GRID_SIZES[] = { 16, 64, 256 };
+	constexpr static int CUBE_COUNTS[] = { 10, 100, 1000 };
+	constexpr static float SCENE_SIZE = 2000.0f;
+
+	for (const auto& resolution : RESOLUTIONS) {
+		int width = resolution[0];
+		int height = resolution[1];
+
+		for (int size : GRID_SIZES) {
+			Engine engine(width, height, flags | HEADLESS);
+
+			Random::seed(SEED);
+
+			Mesh mesh(size, size, SCENE_SIZE / size);
+
+			mesh.setPosition({ -SCENE_SIZE / 2, 0, 100 });
+			engine.addObject(&mesh);
+
+			suite.run("draw/mesh", { { "grid_size", size }, { "width", width }, { "height", height } }, 2 * size * size, [&]() {
+				engine.draw();
+			});
+		}
+
+		for (int count : CUBE_COUNTS) {
+			Engine engine(width, height, flags | HEADLESS);
+			std::vector<Cube*> cubes;
+
+			Random::seed(SEED);
+
+			for (int i = 0; i < count; i++) {
+				Cube* cube = new Cube(Random::nextFloat(10.0f, 60.0f));
+
+				cube->setPosition({ Random::nextFloat(-SCENE_SIZE / 2, SCENE_SIZE / 2), Random::nextFloat(0.0f, 400.0f), Random::nextFloat(200.0f, SCENE_SIZE) });
+				cube->setRotation({ Random::nextFloat(-3.0f, 3.0f), Random::nextFloat(-3.0f, 3.0f), Random::nextFloat(-3.0f, 3.0f) });
+				engine.addObject(cube);
+				cubes.push_back(cube);
+			}
+
+			suite.run("draw/cubes", { { "cubes", count }, { "width", width }, { "height", height } }, 12 * count, [&]() {
+				engine.draw();
+			});
+
+			for (Cube* cube : cubes) {
+				delete cube;
+			}
+		}
+	}
+}
+
+/**
+ * Usage: softengine_bench [--output path] [--filter text] [--min-time ms]
+ *   [--binned] [--half-space] [--depth16] [--depth-prepass] [--sort-triangles]
+ *
+ * Writes results as JSON to the output path, or to stdout, with a
+ * summary of each benchmark on stderr. The rasterization options are
+ * applied to every benchmark they affect, and recorded with the results.
+ */
+int main(int argc, char* argv[]) {
+	const char* outputPath = NULL;
+	const char* filter = NULL;
+	double minTime = 250.0;
+	Uint32 flags = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+			outputPath = argv[++i];
+		} else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+			filter = argv[++i];
+		} else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+			minTime = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--binned") == 0) {
+			flags |= BINNED_RASTERIZATION;
+		} else if (strcmp(argv[i], "--half-space") == 0) {
+			flags |= HALF_SPACE_RASTERIZATION;
+		} else if (strcmp(argv[i], "--depth16") == 0) {
+			flags |= COMPACT_DEPTH;
+		} else if (strcmp(argv[i], "--depth-prepass") == 0) {
+			flags |= DEPTH_PREPASS;
+		} else if (strcmp(argv[i], "--sort-triangles") == 0) {
+			flags |= SORTED_TRIANGLES;
+		} else {
+			fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+
+			return 1;
+		}
+	}
+
+	SDL_Init(SDL_INIT_TIMER);
+
+	BenchmarkSuite suite(filter, minTime);
+	DepthFormat depthFormat = flags & COMPACT_DEPTH ? DEPTH_16 : DEPTH_32;
+	VertexProcessor vertexProcessor;
+
+	benchmarkTransforms(suite);
+	benchmarkProjection(suite);
+	benchmarkScanLines(suite, depthFormat);
+	benchmarkTriangles(suite, SCANLINE_TRAVERSAL, depthFormat);
+	benchmarkTriangles(suite, HALF_SPACE_TRAVERSAL, depthFormat);
+	benchmarkDraw(suite, flags);
+
+	char configuration[256];
+
+	snprintf(
+		configuration, sizeof(configuration),
+		"\"seed\": %d, \"kernel\": \"%s\", \"binned\": %s, \"half_space\": %s, \"depth16\": %s, "
+		"\"depth_prepass\": %s, \"sorted_triangles\": %s",
+		SEED, vertexProcessor.getKernelName(),
+		flags & BINNED_RASTERIZATION ? "true" : "false",
+		flags & HALF_SPACE_RASTERIZATION ? "true" : "false",
+		flags & COMPACT_DEPTH ? "true" : "false",
+		flags & DEPTH_PREPASS ? "true" : "false",
+		flags & SORTED_TRIANGLES ? "true" : "false"
+	);
+
+	FILE* file = outputPath != NULL ? fopen(outputPath, "w") : stdout;
+
+	if (file == NULL) {
+		fprintf(stderr, "Unable to open %s\n", outputPath);
+
+		return 1;
+	}
+
+	bool isWritten = suite.writeJSON(file, configuration);
+
+	if (file != stdout) {
+		isWritten = fclose(file) == 0 && isWritten;
+	}
+
+	SDL_Quit();
+
+	return isWritten ? 0 : 1;
+}
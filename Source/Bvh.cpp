@@ -0,0 +1,262 @@
+#include <float.h>
+#include <algorithm>
+
+#include <Bvh.h>
+#include <Objects.h>
+
+namespace {
+	BoundingBox merge(const BoundingBox& a, const BoundingBox& b) {
+		return {
+			{ std::min(a.min.x, b.min.x), std::min(a.min.y, b.min.y), std::min(a.min.z, b.min.z) },
+			{ std::max(a.max.x, b.max.x), std::max(a.max.y, b.max.y), std::max(a.max.z, b.max.z) }
+		};
+	}
+
+	bool isEqual(const BoundingBox& a, const BoundingBox& b) {
+		return (
+			a.min.x == b.min.x && a.min.y == b.min.y && a.min.z == b.min.z &&
+			a.max.x == b.max.x && a.max.y == b.max.y && a.max.z == b.max.z
+		);
+	}
+}
+
+/**
+ * Detaches the remaining objects, so that they can outlive the
+ * hierarchy.
+ */
+Bvh::~Bvh() {
+	for (int i = 0; i < objects.size(); i++) {
+		objects.at(i)->bvh = NULL;
+	}
+}
+
+void Bvh::add(Object* object) {
+	object->bvh = this;
+
+	objects.push_back(object);
+
+	hasStaleStructure = true;
+}
+
+/**
+ * Recursively partitions a range of objects at the median of their
+ * centers, along the axis over which the centers are most spread out.
+ * Returns the index of the created node.
+ */
+int Bvh::buildNode(int parent, int firstObject, int objectCount) {
+	int index = nodes.size();
+
+	nodes.emplace_back();
+	nodes.at(index).parent = parent;
+	nodes.at(index).firstObject = firstObject;
+	nodes.at(index).objectCount = objectCount;
+
+	if (objectCount <= MAX_LEAF_OBJECTS) {
+		for (int i = firstObject; i < firstObject + objectCount; i++) {
+			objects.at(i)->bvhLeaf = index;
+		}
+
+		updateLeafBounds(nodes.at(index));
+
+		return index;
+	}
+
+	Vec3 minCenter = { FLT_MAX, FLT_MAX, FLT_MAX };
+	Vec3 maxCenter = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	for (int i = firstObject; i < firstObject + objectCount; i++) {
+		Vec3 center = objectBounds.at(i).getCenter();
+
+		minCenter = { std::min(minCenter.x, center.x), std::min(minCenter.y, center.y), std::min(minCenter.z, center.z) };
+		maxCenter = { std::max(maxCenter.x, center.x), std::max(maxCenter.y, center.y), std::max(maxCenter.z, center.z) };
+	}
+
+	Vec3 spread = maxCenter - minCenter;
+	int axis = spread.x >= spread.y && spread.x >= spread.z ? 0 : spread.y >= spread.z ? 1 : 2;
+	int middle = firstObject + objectCount / 2;
+
+	auto getAxisCenter = [=](int i) {
+		Vec3 center = objectBounds.at(i).getCenter();
+
+		return axis == 0 ? center.x : axis == 1 ? center.y : center.z;
+	};
+
+	// Objects and their bounds are partitioned together through an
+	// index permutation, since they're kept in parallel arrays
+	std::vector<int> order(objectCount);
+
+	for (int i = 0; i < objectCount; i++) {
+		order.at(i) = firstObject + i;
+	}
+
+	std::nth_element(order.begin(), order.begin() + (middle - firstObject), order.end(), [&](int a, int b) {
+		return getAxisCenter(a) < getAxisCenter(b);
+	});
+
+	std::vector<Object*> orderedObjects(objectCount);
+	std::vector<BoundingBox> orderedBounds(objectCount);
+
+	for (int i = 0; i < objectCount; i++) {
+		orderedObjects.at(i) = objects.at(order.at(i));
+		orderedBounds.at(i) = objectBounds.at(order.at(i));
+	}
+
+	std::copy(orderedObjects.begin(), orderedObjects.end(), objects.begin() + firstObject);
+	std::copy(orderedBounds.begin(), orderedBounds.end(), objectBounds.begin() + firstObject);
+
+	int left = buildNode(index, firstObject, middle - firstObject);
+	int right = buildNode(index, middle, firstObject + objectCount - middle);
+	Node& node = nodes.at(index);
+
+	node.left = left;
+	node.right = right;
+	node.bounds = merge(nodes.at(left).bounds, nodes.at(right).bounds);
+
+	return index;
+}
+
+/**
+ * Flags the leaf containing an object for refitting, after the
+ * object has moved or rotated.
+ */
+void Bvh::markDirty(Object* object) {
+	if (hasStaleStructure) {
+		return;
+	}
+
+	Node& leaf = nodes.at(object->bvhLeaf);
+
+	if (!leaf.isDirty) {
+		leaf.isDirty = true;
+
+		dirtyLeaves.push_back(object->bvhLeaf);
+	}
+}
+
+/**
+ * Collects every object whose world-space bounds may intersect the
+ * given world-space frustum. Subtrees entirely inside of the frustum
+ * are collected without testing their descendants.
+ */
+void Bvh::query(const Frustum& frustum, std::vector<Object*>& results) {
+	if (nodes.empty()) {
+		return;
+	}
+
+	int stack[64];
+	int stackSize = 0;
+
+	stack[stackSize++] = 0;
+
+	while (stackSize > 0) {
+		const Node& node = nodes[stack[--stackSize]];
+		bool isContained = true;
+		bool isRejected = false;
+
+		for (int p = 0; p < 6 && !isRejected; p++) {
+			const Plane& plane = frustum.planes[p];
+
+			// The box corners furthest along and against the plane
+			// normal determine whether it's entirely in front of
+			// or behind the plane
+			Vec3 nearest = {
+				plane.normal.x >= 0 ? node.bounds.max.x : node.bounds.min.x,
+				plane.normal.y >= 0 ? node.bounds.max.y : node.bounds.min.y,
+				plane.normal.z >= 0 ? node.bounds.max.z : node.bounds.min.z
+			};
+
+			Vec3 furthest = {
+				plane.normal.x >= 0 ? node.bounds.min.x : node.bounds.max.x,
+				plane.normal.y >= 0 ? node.bounds.min.y : node.bounds.max.y,
+				plane.normal.z >= 0 ? node.bounds.min.z : node.bounds.max.z
+			};
+
+			isRejected = plane.distanceTo(nearest) < 0;
+			isContained = isContained && plane.distanceTo(furthest) >= 0;
+		}
+
+		if (isRejected) {
+			continue;
+		}
+
+		if (isContained || node.left == -1) {
+			results.insert(results.end(), objects.begin() + node.firstObject, objects.begin() + node.firstObject + node.objectCount);
+		} else {
+			stack[stackSize++] = node.right;
+			stack[stackSize++] = node.left;
+		}
+	}
+}
+
+void Bvh::rebuild() {
+	nodes.clear();
+	dirtyLeaves.clear();
+	objectBounds.resize(objects.size());
+
+	for (int i = 0; i < objects.size(); i++) {
+		objectBounds.at(i) = objects.at(i)->getWorldBounds();
+	}
+
+	if (!objects.empty()) {
+		nodes.reserve(2 * objects.size() / MAX_LEAF_OBJECTS + 1);
+
+		buildNode(-1, 0, objects.size());
+	}
+
+	hasStaleStructure = false;
+}
+
+/**
+ * Brings the hierarchy up to date with every change since the last
+ * refit. Dirty leaves recompute their bounds, which are propagated
+ * towards the root until an ancestor's bounds remain unchanged.
+ */
+void Bvh::refit() {
+	if (hasStaleStructure) {
+		rebuild();
+		return;
+	}
+
+	for (int i = 0; i < dirtyLeaves.size(); i++) {
+		Node& leaf = nodes.at(dirtyLeaves.at(i));
+
+		for (int o = leaf.firstObject; o < leaf.firstObject + leaf.objectCount; o++) {
+			objectBounds.at(o) = objects.at(o)->getWorldBounds();
+		}
+
+		updateLeafBounds(leaf);
+
+		leaf.isDirty = false;
+
+		for (int n = leaf.parent; n != -1; n = nodes.at(n).parent) {
+			Node& node = nodes.at(n);
+			BoundingBox bounds = merge(nodes.at(node.left).bounds, nodes.at(node.right).bounds);
+
+			if (isEqual(bounds, node.bounds)) {
+				break;
+			}
+
+			node.bounds = bounds;
+		}
+	}
+
+	dirtyLeaves.clear();
+}
+
+/**
+ * Removes an object from the hierarchy, e.g. when it's destroyed.
+ */
+void Bvh::remove(Object* object) {
+	objects.erase(std::remove(objects.begin(), objects.end(), object), objects.end());
+
+	object->bvh = NULL;
+	hasStaleStructure = true;
+}
+
+void Bvh::updateLeafBounds(Node& node) {
+	node.bounds = objectBounds.at(node.firstObject);
+
+	for (int i = node.firstObject + 1; i < node.firstObject + node.objectCount; i++) {
+		node.bounds = merge(node.bounds, objectBounds.at(i));
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include <Types.h>
+
+struct Object;
+
+/**
+ * A bounding volume hierarchy over the world-space bounds of a set of
+ * objects, allowing the objects intersecting a frustum to be found
+ * without visiting each one. Objects report changes to their position
+ * or rotation, and only the affected nodes are refit before the next
+ * query. Adding objects rebuilds the hierarchy from scratch.
+ */
+class Bvh {
+	public:
+		~Bvh();
+		void add(Object* object);
+		void markDirty(Object* object);
+		void query(const Frustum& frustum, std::vector<Object*>& results);
+		void refit();
+		void remove(Object* object);
+	private:
+		constexpr static int MAX_LEAF_OBJECTS = 4;
+
+		/**
+		 * Each node covers a contiguous range of the ordered objects.
+		 * Internal nodes have two children; leaves have none.
+		 */
+		struct Node {
+			BoundingBox bounds;
+			int parent = -1;
+			int left = -1;
+			int right = -1;
+			int firstObject = 0;
+			int objectCount = 0;
+			bool isDirty = false;
+		};
+
+		std::vector<Node> nodes;
+		std::vector<Object*> objects;
+		std::vector<BoundingBox> objectBounds;
+		std::vector<int> dirtyLeaves;
+		bool hasStaleStructure = false;
+		int buildNode(int parent, int firstObject, int objectCount);
+		void rebuild();
+		void updateLeafBounds(Node& node);
+};
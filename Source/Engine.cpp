@@ -1,45 +1,106 @@
 #define _CRT_SECURE_NO_WARNINGS
+#define _USE_MATH_DEFINES
 
 #include <SDL.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
 #include <time.h>
+#include <limits.h>
+#include <float.h>
+#include <algorithm>
+#include <thread>
 #include <Objects.h>
 #include <Rasterizer.h>
 #include <Helpers.h>
 #include <Engine.h>
+#include <Profiler.h>
+#include <Random.h>
 
 Engine::Engine(int width, int height, Uint32 flags) {
-	SDL_Init(SDL_INIT_EVERYTHING);
-
-	window = SDL_CreateWindow(
-		"HEY ZACK",
-		SDL_WINDOWPOS_CENTERED,
-		SDL_WINDOWPOS_CENTERED,
-		width, height,
-		SDL_WINDOW_SHOWN
-	);
+	if (flags & HEADLESS) {
+		// Headless engines render into an in-memory framebuffer,
+		// and never touch the video subsystem
+		SDL_Init(SDL_INIT_TIMER);
+
+		framebuffer = new FramebufferTarget(width, height);
+		renderTarget = framebuffer;
+	} else {
+		SDL_Init(SDL_INIT_EVERYTHING);
+
+		window = SDL_CreateWindow(
+			"HEY ZACK",
+			SDL_WINDOWPOS_CENTERED,
+			SDL_WINDOWPOS_CENTERED,
+			width, height,
+			SDL_WINDOW_SHOWN
+		);
+
+		renderTarget = new SDLRenderTarget(window, width, height, flags & DEBUG_DRAWTIME ? 0 : SDL_RENDERER_PRESENTVSYNC);
+	}
 
-	renderer = SDL_CreateRenderer(window, -1, flags & DEBUG_DRAWTIME ? 0 : SDL_RENDERER_PRESENTVSYNC);
-	rasterizer = new Rasterizer(renderer, width, height);
+	rasterizer = new Rasterizer(renderTarget, width, height);
+
+	if (flags & BINNED_RASTERIZATION) {
+		rasterizer->enableBinning(std::thread::hardware_concurrency());
+	}
+
+	if (flags & HALF_SPACE_RASTERIZATION) {
+		rasterizer->setTraversal(HALF_SPACE_TRAVERSAL);
+	}
+
+	if (flags & PIPELINED_PRESENTATION) {
+		rasterizer->enablePresentThread(3);
+	}
+
+	if (flags & COMPACT_DEPTH) {
+		rasterizer->setDepthFormat(DEPTH_16);
+	}
+
+	if (flags & DIRECT_PRESENTATION) {
+		rasterizer->setPresentMode(PRESENT_DIRECT);
+	}
+
+	if (flags & DEPTH_PREPASS) {
+		rasterizer->setDepthPrepass(true);
+	}
 
 	this->width = width;
 	this->height = height;
 	this->flags = flags;
+
+	Profiler::setScreenSize(width, height);
 }
 
 Engine::~Engine() {
 	objects.clear();
 	delete rasterizer;
+	delete renderTarget;
+
+	if (window != NULL) {
+		SDL_DestroyWindow(window);
+	}
 
-	SDL_DestroyRenderer(renderer);
-	SDL_DestroyWindow(window);
 	SDL_Quit();
 }
 
 void Engine::addObject(Object* object) {
 	objects.push_back(object);
+	bvh.add(object);
+
+	totalPolygons += object->getPolygonCount();
+}
+
+/**
+ * Adds each of a terrain's chunks as an object. Chunk levels of
+ * detail are selected at the start of every frame.
+ */
+void Engine::addTerrain(Terrain* terrain) {
+	terrains.push_back(terrain);
+
+	for (TerrainChunk* chunk : terrain->getChunks()) {
+		addObject(chunk);
+	}
 }
 
 void Engine::delay(int ms) {
@@ -52,59 +113,475 @@ void Engine::delay(int ms) {
 	}
 }
 
+/**
+ * Builds the view-space frustum bounding everything which can appear
+ * on screen. A view-space point projects to a screen x of f * x / z +
+ * halfWidth, with f the focal length, so it's on screen horizontally
+ * when f * x + halfWidth * z >= 0 and halfWidth * z - f * x >= 0, and
+ * likewise vertically. These are exactly the side planes.
+ */
+Frustum Engine::createViewFrustum(float focalLength) {
+	Frustum frustum;
+	float halfWidth = width / 2.0f;
+	float halfHeight = height / 2.0f;
+	float xLength = sqrt(focalLength * focalLength + halfWidth * halfWidth);
+	float yLength = sqrt(focalLength * focalLength + halfHeight * halfHeight);
+
+	frustum.planes[0] = { { 0, 0, 1 }, -camera.nearDistance };
+	frustum.planes[1] = { { 0, 0, -1 }, camera.farDistance };
+	frustum.planes[2] = { { focalLength / xLength, 0, halfWidth / xLength }, 0 };
+	frustum.planes[3] = { { -focalLength / xLength, 0, halfWidth / xLength }, 0 };
+	frustum.planes[4] = { { 0, focalLength / yLength, halfHeight / yLength }, 0 };
+	frustum.planes[5] = { { 0, -focalLength / yLength, halfHeight / yLength }, 0 };
+
+	return frustum;
+}
+
 void Engine::draw() {
-	RotationMatrix rotationMatrix = RotationMatrix::calculate(camera.rotation);
-	int fovScalar = 500 * (360 / camera.fov);
+	PROFILE_SCOPE(PROFILE_OTHER, "draw");
+
+	RotationMatrix viewRotation = RotationMatrix::calculate(camera.rotation);
+	float halfWidth = width / 2.0f;
+	float halfHeight = height / 2.0f;
 
-	for (int o = 0; o < objects.size(); o++) {
-		Object* object = objects.at(o);
-		Vec3 relativeObjectPosition = object->position - camera.position;
+	// The field of view spans the width of the screen
+	float focalLength = halfWidth / tan(camera.fov * M_PI / 360);
 
-		object->forEachPolygon([=](const Polygon& polygon) {
-			Triangle triangle;
-			bool isInView = false;
+	Matrix4 view = Matrix4::createTransform(viewRotation, viewRotation * (camera.position * -1.0f));
+	Matrix4 viewProjection = Matrix4::createPerspective(focalLength, halfWidth, halfHeight, camera.nearDistance, camera.farDistance) * view;
+	Frustum frustum = createViewFrustum(focalLength);
 
-			for (int i = 0; i < 3; i++) {
-				Vec3 vertex = rotationMatrix * (relativeObjectPosition + polygon.vertices[i]->vector);
-				Vec3 unitVertex = vertex.unit();
-				float distortionCorrectedZ = unitVertex.z * std::abs(std::cos(unitVertex.x));
-				int x = (int)(fovScalar * unitVertex.x / (1 + unitVertex.z) + width / 2);
-				int y = (int)(fovScalar * -unitVertex.y / (1 + distortionCorrectedZ) + height / 2);
+	cullStatistics = CullStatistics();
 
-				if (!isInView && vertex.z > 0) {
-					isInView = true;
-				}
+	// The rasterizer specializes its pipeline to the render mode once
+	// per frame, rather than the mode being tested for every triangle
+	RasterState state;
+
+	state.isWireframe = flags & SHOW_WIREFRAME;
+	state.depthTest = (flags & SHOW_WIREFRAME) && !(flags & DEPTH_TESTED_WIREFRAME) ? DEPTH_ALWAYS : DEPTH_LESS;
+	state.shading = flags & FLAT_SHADING ? SHADE_FLAT : SHADE_TEXTURED;
+
+	rasterizer->setColor(255, 255, 255);
+	rasterizer->setState(state);
+
+	for (int t = 0; t < terrains.size(); t++) {
+		terrains.at(t)->selectLevels(camera.position, focalLength);
+	}
+
+	// Only objects whose world-space bounds intersect the frustum
+	// are visited, so that the cost of the remaining per-object
+	// work depends on what's visible rather than on scene size
+	{
+		PROFILE_SCOPE(PROFILE_CULL, "visibility");
+
+		bvh.refit();
+		visibleObjects.clear();
+		bvh.query(frustum.toWorldSpace(viewRotation, camera.position), visibleObjects);
+	}
+
+	cullStatistics.frustumObjects = objects.size() - visibleObjects.size();
+
+	// Objects are drawn front to back, so that farther objects are
+	// hidden by nearer ones as early as possible, and their pixels
+	// fail the depth test rather than being shaded and overwritten
+	{
+		PROFILE_SCOPE(PROFILE_CULL, "sort");
+
+		sortedObjects.clear();
+
+		for (Object* object : visibleObjects) {
+			const BoundingBox& bounds = object->getWorldBounds();
+			Vec4 center = view * bounds.getCenter();
+
+			sortedObjects.push_back({ object, center.z - bounds.getRadius() });
+		}
+
+		std::sort(sortedObjects.begin(), sortedObjects.end(), [](const SortedObject& a, const SortedObject& b) {
+			return a.depth < b.depth;
+		});
+	}
+
+	{
+		PROFILE_SCOPE(PROFILE_CULL, "objects");
+
+		for (int o = 0; o < sortedObjects.size(); o++) {
+			drawObject(sortedObjects.at(o).object, view, viewProjection, frustum);
+		}
+	}
+
+	rasterizer->render();
+
+	cullStatistics.occludedTriangles = rasterizer->getOccludedTriangleCount();
+
+	int culledTriangles = (
+		cullStatistics.nearPlaneTriangles + cullStatistics.offScreenTriangles + cullStatistics.degenerateTriangles +
+		cullStatistics.facingTriangles + cullStatistics.subpixelTriangles + cullStatistics.occludedTriangles
+	);
 
-				triangle.createVertex(i, x, y, (int)vertex.z, polygon.vertices[i]->color);
+	PROFILE_COUNT(PROFILE_TRIANGLES_SUBMITTED, culledTriangles + cullStatistics.drawnTriangles - cullStatistics.occludedTriangles);
+	PROFILE_COUNT(PROFILE_TRIANGLES_CULLED, culledTriangles);
+	PROFILE_COUNT(PROFILE_TRIANGLES_DRAWN, cullStatistics.drawnTriangles - cullStatistics.occludedTriangles);
+}
+
+/**
+ * Clips a polygon which crosses the near plane or the guard band in
+ * clip space, and draws what remains of it as a fan of triangles.
+ * Clipping in clip space keeps the projected vertices exact, and the
+ * colors and texture coordinates interpolated along the clipped edges
+ * perspective-correct.
+ */
+void Engine::drawClippedPolygon(Object* object, const ProjectionParameters& projection, const uint32_t* polygon) {
+	VertexSpan positions = object->getPositions();
+	Span<Color> colors = object->getColors();
+	Span<TextureCoordinate> uvs = object->getUvs();
+
+	// Each of the five clipping planes can add at most one vertex
+	constexpr int MAX_VERTICES = 8;
+	Vec4 vertices[2][MAX_VERTICES];
+	Color vertexColors[2][MAX_VERTICES];
+	TextureCoordinate vertexUvs[2][MAX_VERTICES];
+	int totalVertices = 3;
+
+	for (int i = 0; i < 3; i++) {
+		uint32_t v = polygon[i];
+
+		vertices[0][i] = projection.transform * Vec3(positions.x[v], positions.y[v], positions.z[v]);
+		vertexColors[0][i] = colors[v];
+
+		if (objectTexture != NULL) {
+			vertexUvs[0][i] = uvs[v];
+		}
+	}
+
+	if (vertices[0][0].z < 0 && vertices[0][1].z < 0 && vertices[0][2].z < 0) {
+		cullStatistics.nearPlaneTriangles++;
+		return;
+	}
+
+	// Signed distances to the near plane, then to each side of the
+	// guard band, which are non-negative inside of them
+	auto getDistance = [](const Vec4& vertex, int plane) {
+		switch (plane) {
+			case 0: return vertex.z;
+			case 1: return vertex.x + GUARD_BAND * vertex.w;
+			case 2: return GUARD_BAND * vertex.w - vertex.x;
+			case 3: return vertex.y + GUARD_BAND * vertex.w;
+			default: return GUARD_BAND * vertex.w - vertex.y;
+		}
+	};
+
+	int input = 0;
+
+	for (int plane = 0; plane < 5 && totalVertices >= 3; plane++) {
+		int output = 1 - input;
+		int totalClippedVertices = 0;
+
+		for (int i = 0; i < totalVertices; i++) {
+			int next = (i + 1) % totalVertices;
+			const Vec4& vertex = vertices[input][i];
+			const Vec4& nextVertex = vertices[input][next];
+			float distance = getDistance(vertex, plane);
+			float nextDistance = getDistance(nextVertex, plane);
+
+			if (distance >= 0) {
+				vertices[output][totalClippedVertices] = vertex;
+				vertexColors[output][totalClippedVertices] = vertexColors[input][i];
+				vertexUvs[output][totalClippedVertices++] = vertexUvs[input][i];
 			}
 
-			if (isInView) {
-				if (flags & SHOW_WIREFRAME) {
-					rasterizer->setColor(255, 255, 255);
-
-					rasterizer->triangle(
-						triangle.vertices[0].coordinate.x, triangle.vertices[0].coordinate.y,
-						triangle.vertices[1].coordinate.x, triangle.vertices[1].coordinate.y,
-						triangle.vertices[2].coordinate.x, triangle.vertices[2].coordinate.y
-					);
-				} else {
-					rasterizer->triangle(triangle);
-				}
+			if ((distance >= 0) != (nextDistance >= 0)) {
+				float t = distance / (distance - nextDistance);
+				const TextureCoordinate& uv = vertexUvs[input][i];
+				const TextureCoordinate& nextUv = vertexUvs[input][next];
+
+				vertices[output][totalClippedVertices] = vertex + (nextVertex - vertex) * t;
+				vertexColors[output][totalClippedVertices] = lerp(vertexColors[input][i], vertexColors[input][next], t);
+				vertexUvs[output][totalClippedVertices++] = { uv.u + (nextUv.u - uv.u) * t, uv.v + (nextUv.v - uv.v) * t };
 			}
-		});
+		}
+
+		totalVertices = totalClippedVertices;
+		input = output;
+	}
+
+	if (totalVertices < 3) {
+		cullStatistics.nearPlaneTriangles++;
+		return;
 	}
 
-	rasterizer->render(renderer);
+	Triangle triangle;
+
+	triangle.texture = objectTexture;
+
+	for (int i = 0; i < totalVertices; i++) {
+		Vec3 screenVertex = VertexProcessor::divide(vertices[input][i]);
+		Vertex2d& vertex = triangle.vertices[std::min(i, 2)];
+
+		// Vertices on the near plane may round to just behind it
+		screenVertex.z = std::max(screenVertex.z, 0.0f);
+
+		// The clipped polygon is drawn as a fan around its first
+		// vertex, preserving its winding order
+		vertex.set(screenVertex.x, screenVertex.y, (int)screenVertex.z, vertexColors[input][i]);
+		vertex.uv = vertexUvs[input][i];
+		vertex.inverseW = 1.0f / vertices[input][i].w;
+
+		if (i >= 2) {
+			drawTriangle(triangle);
+
+			triangle.vertices[1] = triangle.vertices[2];
+		}
+	}
 }
 
-int Engine::getPolygonCount() {
-	int total = 0;
+/**
+ * Draws an object's visible polygons. The object's own transform is
+ * combined with the view and projection, so that each vertex is
+ * carried from model space onto the screen by a single matrix.
+ */
+void Engine::drawObject(Object* object, const Matrix4& view, const Matrix4& viewProjection, const Frustum& frustum) {
+	const BoundingBox& objectBounds = object->getBounds();
+	Matrix4 model = Matrix4::createTransform(object->getTransform(), object->getPosition());
+	Vec4 center = view * model * objectBounds.getCenter();
+
+	if (!frustum.intersectsSphere({ center.x, center.y, center.z }, objectBounds.getRadius() * object->getScale())) {
+		cullStatistics.frustumObjects++;
+		return;
+	}
+
+	ProjectionParameters projection;
+
+	projection.transform = viewProjection * model;
+
+	VertexSpan positions = object->getPositions();
+	Span<Color> colors = object->getColors();
+	Span<TextureCoordinate> uvs = object->getUvs();
+	Span<uint32_t> indices = object->getIndices();
+	int vertexCount = object->getVertexCount();
+
+	// Objects are only textured if their meshes can be
+	objectTexture = uvs.size >= vertexCount ? object->getTexture().get() : NULL;
+
+	Rect bounds = { INT_MAX, INT_MAX, INT_MIN, INT_MIN };
+	int minDepth = INT_MAX;
+	int maxDepth = INT_MIN;
+	bool isEntirelyInView = true;
+
+	{
+		PROFILE_STAGE(PROFILE_TRANSFORM);
+
+		// Transform and project every vertex exactly once, caching the
+		// results for all of the polygons which share it
+		vertexProcessor.project(projection, positions, vertexCount, projectedVertices);
+
+		transformedVertices.resize(vertexCount);
+
+		for (int v = 0; v < vertexCount; v++) {
+			float depth = projectedVertices.z[v];
+			TransformedVertex& transformedVertex = transformedVertices[v];
+
+			transformedVertex.vertex.set(projectedVertices.x[v], projectedVertices.y[v], (int)depth, colors[v]);
+			transformedVertex.isInView = depth >= 0;
+
+			if (objectTexture != NULL) {
+				transformedVertex.vertex.uv = uvs[v];
+				transformedVertex.vertex.inverseW = projectedVertices.inverseW[v];
+			}
+
+			bounds.left = std::min(bounds.left, transformedVertex.vertex.coordinate.x);
+			bounds.right = std::max(bounds.right, transformedVertex.vertex.coordinate.x);
+			bounds.top = std::min(bounds.top, transformedVertex.vertex.coordinate.y);
+			bounds.bottom = std::max(bounds.bottom, transformedVertex.vertex.coordinate.y);
+			minDepth = std::min(minDepth, transformedVertex.vertex.depth);
+			maxDepth = std::max(maxDepth, transformedVertex.vertex.depth);
+			isEntirelyInView = isEntirelyInView && transformedVertex.isInView;
+		}
+	}
+
+	if (isEntirelyInView) {
+		// Skip objects hidden behind previously drawn geometry. Vertices
+		// behind the near plane have no meaningful projection, so objects
+		// crossing it can't be tested by their screen bounds.
+		bounds.left = std::max(bounds.left, 0);
+		bounds.right = std::min(bounds.right + 1, width);
+		bounds.top = std::max(bounds.top, 0);
+		bounds.bottom = std::min(bounds.bottom + 1, height);
+
+		if (rasterizer->isOccluded(bounds, minDepth)) {
+			cullStatistics.occludedObjects++;
+			return;
+		}
+	}
+
+	// Polygons are timed per object rather than per triangle, which
+	// would cost more than setting up most triangles. Binned triangles
+	// are only set up here, and filled later tile by tile.
+	PROFILE_STAGE((flags & BINNED_RASTERIZATION) ? PROFILE_SETUP : PROFILE_FILL);
+
+	if (flags & SORTED_TRIANGLES) {
+		drawSortedPolygons(object, projection, minDepth, maxDepth);
+	} else {
+		for (int p = 0; p < indices.size; p += 3) {
+			drawPolygon(object, projection, &indices[p]);
+		}
+	}
+}
+
+/**
+ * Draws one of an object's polygons from its transformed vertices,
+ * clipping it if any of them are behind the near plane.
+ */
+void Engine::drawPolygon(Object* object, const ProjectionParameters& projection, const uint32_t* polygon) {
+	Triangle triangle;
+	int totalVerticesInView = 0;
 
-	for (int o = 0; o < objects.size(); o++) {
-		total += objects.at(o)->getPolygonCount();
+	triangle.texture = objectTexture;
+
+	for (int i = 0; i < 3; i++) {
+		const TransformedVertex& transformedVertex = transformedVertices[polygon[i]];
+
+		triangle.vertices[i] = transformedVertex.vertex;
+		totalVerticesInView += transformedVertex.isInView;
 	}
 
-	return total;
+	if (totalVerticesInView == 3) {
+		drawTriangle(triangle);
+	} else {
+		drawClippedPolygon(object, projection, polygon);
+	}
+}
+
+/**
+ * Draws an object's polygons roughly front to back, so that within
+ * large objects like terrain, nearer polygons hide farther ones too.
+ * Polygons are counting sorted by their nearest vertex into
+ * POLYGON_BUCKETS buckets spanning the object's depth range, which
+ * takes linear time. Polygons crossing the near plane are as near as
+ * can be, so they're drawn straight away.
+ */
+void Engine::drawSortedPolygons(Object* object, const ProjectionParameters& projection, int minDepth, int maxDepth) {
+	constexpr Uint8 UNSORTED = 0xFF;
+
+	Span<uint32_t> indices = object->getIndices();
+	int bucketStarts[POLYGON_BUCKETS + 1] = { };
+	long long nearestDepth = std::max(minDepth, 0);
+	long long depthRange = std::max((long long)maxDepth - nearestDepth + 1, 1LL);
+
+	polygonBuckets.resize(indices.size / 3);
+
+	for (int p = 0; p < indices.size; p += 3) {
+		const TransformedVertex& v1 = transformedVertices[indices[p]];
+		const TransformedVertex& v2 = transformedVertices[indices[p + 1]];
+		const TransformedVertex& v3 = transformedVertices[indices[p + 2]];
+
+		if (!v1.isInView || !v2.isInView || !v3.isInView) {
+			drawClippedPolygon(object, projection, &indices[p]);
+
+			polygonBuckets[p / 3] = UNSORTED;
+			continue;
+		}
+
+		int depth = std::min({ v1.vertex.depth, v2.vertex.depth, v3.vertex.depth });
+		int bucket = (int)((depth - nearestDepth) * POLYGON_BUCKETS / depthRange);
+
+		polygonBuckets[p / 3] = bucket;
+		bucketStarts[bucket + 1]++;
+	}
+
+	for (int b = 0; b < POLYGON_BUCKETS; b++) {
+		bucketStarts[b + 1] += bucketStarts[b];
+	}
+
+	sortedPolygons.resize(bucketStarts[POLYGON_BUCKETS]);
+
+	for (int p = 0; p < indices.size; p += 3) {
+		Uint8 bucket = polygonBuckets[p / 3];
+
+		if (bucket != UNSORTED) {
+			sortedPolygons[bucketStarts[bucket]++] = p;
+		}
+	}
+
+	for (int p : sortedPolygons) {
+		drawPolygon(object, projection, &indices[p]);
+	}
+}
+
+/**
+ * Submits a projected triangle to the rasterizer. Triangles reaching
+ * here lie within the guard band, well inside the range the rasterizer
+ * can handle without clipping (see SUBPIXEL_LIMIT). This lets triangles
+ * overlapping the screen edges be passed on as-is, while triangles
+ * entirely off-screen are discarded here.
+ *
+ * Triangles with zero area, triangles facing away according to the
+ * cull mode, and triangles too small to cover any pixel center are
+ * discarded as well, before paying for any rasterizer setup.
+ */
+void Engine::drawTriangle(Triangle& triangle) {
+	const Coordinate& c1 = triangle.vertices[0].coordinate;
+	const Coordinate& c2 = triangle.vertices[1].coordinate;
+	const Coordinate& c3 = triangle.vertices[2].coordinate;
+
+	bool isOffScreen = (
+		std::max({ c1.x, c2.x, c3.x }) < 0 ||
+		std::min({ c1.x, c2.x, c3.x }) >= width ||
+		std::max({ c1.y, c2.y, c3.y }) < 0 ||
+		std::min({ c1.y, c2.y, c3.y }) >= height
+	);
+
+	if (isOffScreen) {
+		cullStatistics.offScreenTriangles++;
+		return;
+	}
+
+	const Coordinate& s1 = triangle.vertices[0].subpixel;
+	const Coordinate& s2 = triangle.vertices[1].subpixel;
+	const Coordinate& s3 = triangle.vertices[2].subpixel;
+
+	// Twice the signed area, which is positive for clockwise
+	// (front-facing) triangles since screen y points down
+	long long area = (long long)(s2.x - s1.x) * (s3.y - s1.y) - (long long)(s3.x - s1.x) * (s2.y - s1.y);
+
+	if (area == 0) {
+		cullStatistics.degenerateTriangles++;
+		return;
+	}
+
+	if ((cullMode == CULL_BACK && area < 0) || (cullMode == CULL_FRONT && area > 0)) {
+		cullStatistics.facingTriangles++;
+		return;
+	}
+
+	// Pixels are sampled at their centers, so triangles whose sub-pixel
+	// extents fall between two adjacent centers on either axis are empty
+	constexpr int ONE = 1 << SUBPIXEL_BITS;
+	constexpr int HALF = ONE / 2;
+
+	bool isSubpixel = (
+		(std::min({ s1.x, s2.x, s3.x }) - HALF + ONE - 1) >> SUBPIXEL_BITS > (std::max({ s1.x, s2.x, s3.x }) - HALF) >> SUBPIXEL_BITS ||
+		(std::min({ s1.y, s2.y, s3.y }) - HALF + ONE - 1) >> SUBPIXEL_BITS > (std::max({ s1.y, s2.y, s3.y }) - HALF) >> SUBPIXEL_BITS
+	);
+
+	if (isSubpixel) {
+		cullStatistics.subpixelTriangles++;
+		return;
+	}
+
+	cullStatistics.drawnTriangles++;
+
+	rasterizer->triangle(triangle);
+}
+
+int Engine::getPolygonCount() {
+	return totalPolygons;
+}
+
+/**
+ * Names the path frames are currently presented through.
+ */
+const char* Engine::getPresentPath() {
+	return rasterizer->getPresentMode() == PRESENT_DIRECT ? "direct" : "copy";
 }
 
 void Engine::handleEvent(const SDL_Event& event) {
@@ -153,32 +630,92 @@ void Engine::handleMouseMotionEvent(const SDL_MouseMotionEvent& event) {
 	lastMouseCoordinate.y = event.y;
 }
 
+/**
+ * Prints statistics of a run's frame times, followed by the culling
+ * statistics and profile of its last frames.
+ */
+void Engine::printFrameTimings(std::vector<double>& frameTimes) {
+	int totalFrames = frameTimes.size();
+
+	if (totalFrames == 0) {
+		return;
+	}
+
+	double totalTime = 0.0;
+
+	for (double frameTime : frameTimes) {
+		totalTime += frameTime;
+	}
+
+	std::sort(frameTimes.begin(), frameTimes.end());
+
+	printf(
+		"Frames: %d, Polygons: %d, Total: %.2fms, Average: %.3fms, Min: %.3fms, Median: %.3fms, 95th: %.3fms, Max: %.3fms, Present: %s\n",
+		totalFrames, getPolygonCount(), totalTime, totalTime / totalFrames, frameTimes.front(), frameTimes.at(totalFrames / 2),
+		frameTimes.at(totalFrames * 95 / 100), frameTimes.back(), getPresentPath()
+	);
+
+	printCullStatistics();
+
+	if (Profiler::isEnabled()) {
+		char summary[256];
+
+		Profiler::formatSummary(summary, sizeof(summary));
+		printf("Profile of the last %d frames - %s\n", std::min(totalFrames, Profiler::HISTORY_SIZE), summary);
+	}
+}
+
+/**
+ * Prints the number of objects and triangles discarded by each
+ * culling stage during the most recent frame.
+ */
+void Engine::printCullStatistics() {
+	printf(
+		"Culled objects - Frustum: %d, Occluded: %d\n",
+		cullStatistics.frustumObjects, cullStatistics.occludedObjects
+	);
+
+	printf(
+		"Culled triangles - Near plane: %d, Off-screen: %d, Degenerate: %d, %s: %d, Sub-pixel: %d, Occluded: %d, Drawn: %d\n",
+		cullStatistics.nearPlaneTriangles, cullStatistics.offScreenTriangles, cullStatistics.degenerateTriangles,
+		cullMode == CULL_FRONT ? "Front-facing" : "Back-facing", cullStatistics.facingTriangles,
+		cullStatistics.subpixelTriangles, cullStatistics.occludedTriangles, cullStatistics.drawnTriangles
+	);
+}
+
 void Engine::run() {
-	int lastStartTime;
+	Uint64 frequency = SDL_GetPerformanceFrequency();
 	bool isRunning = true;
 
 	while (isRunning) {
-		lastStartTime = SDL_GetTicks();
+		Uint64 startTime = SDL_GetPerformanceCounter();
 
 		updateMovement();
+		recordFrame();
 		draw();
 
-		int delta = SDL_GetTicks() - lastStartTime;
+		double delta = 1000.0 * (SDL_GetPerformanceCounter() - startTime) / frequency;
 
 		if (flags & DEBUG_DRAWTIME) {
 			if (delta < 17) {
-				delay(17 - delta);
+				delay(17 - (int)delta);
 			} else {
 				printf("[DRAW TIME WARNING] ");
 			}
 			
-			printf("Unlocked delta: %d\n", delta);
+			printf("Unlocked delta: %.2fms, Present: %s\n", delta, getPresentPath());
+			printCullStatistics();
 		}
 
-		int fullDelta = SDL_GetTicks() - lastStartTime;
-		char title[100];
+		// Frame times, and the frame rate, are averaged over the
+		// profiler's recent frames
+		Profiler::endFrame();
 
-		sprintf(title, "Objects: %d, Polygons: %d, FPS: %dfps, Unlocked delta: %dms", objects.size(), getPolygonCount(), (int)round(60 * 17 / fullDelta), delta);
+		char summary[256];
+		char title[400];
+
+		Profiler::formatSummary(summary, sizeof(summary));
+		sprintf(title, "Objects: %d, Polygons: %d, %s, Unlocked delta: %.2fms, Present: %s", objects.size(), getPolygonCount(), summary, delta, getPresentPath());
 
 		SDL_SetWindowTitle(window, title);
 
@@ -194,6 +731,101 @@ void Engine::run() {
 			}
 		}
 	}
+
+	rasterizer->finish();
+}
+
+/**
+ * Draws a fixed number of frames as fast as possible, without
+ * handling any input, and reports frame time statistics. Paired
+ * with the HEADLESS flag this yields repeatable measurements of
+ * the rendering pipeline, free of vsync and window overhead.
+ */
+void Engine::run(int totalFrames) {
+	Uint64 frequency = SDL_GetPerformanceFrequency();
+	std::vector<double> frameTimes;
+
+	for (int frame = 0; frame < totalFrames; frame++) {
+		Uint64 startTime = SDL_GetPerformanceCounter();
+
+		updateMovement();
+		recordFrame();
+		draw();
+
+		frameTimes.push_back(1000.0 * (SDL_GetPerformanceCounter() - startTime) / frequency);
+
+		Profiler::endFrame();
+	}
+
+	rasterizer->finish();
+
+	printFrameTimings(frameTimes);
+}
+
+/**
+ * Replays a recorded session as fast as possible, placing the camera
+ * as it was during each recorded frame, and reports frame time
+ * statistics. Frames advance at a fixed step of one recorded frame
+ * each, however long they take to draw, so every replay of the same
+ * recording draws exactly the same frames. Per-frame timings can be
+ * written with the profiler (see Profiler::openCsv()).
+ */
+void Engine::replay(const Recording& recording) {
+	Uint64 frequency = SDL_GetPerformanceFrequency();
+	std::vector<double> frameTimes;
+
+	for (int frame = 0; frame < recording.getFrameCount(); frame++) {
+		const CameraPose& pose = recording.getFrame(frame);
+		Uint64 startTime = SDL_GetPerformanceCounter();
+
+		camera.position = pose.position;
+		camera.rotation = pose.rotation;
+
+		draw();
+
+		frameTimes.push_back(1000.0 * (SDL_GetPerformanceCounter() - startTime) / frequency);
+
+		Profiler::endFrame();
+	}
+
+	rasterizer->finish();
+
+	printFrameTimings(frameTimes);
+}
+
+/**
+ * Starts recording the camera's pose during every frame drawn by
+ * run(), along with the scene's seed and the screen size, until the
+ * engine is destroyed or recording is stopped by passing NULL.
+ */
+void Engine::record(Recording* recording) {
+	this->recording = recording;
+
+	if (recording != NULL) {
+		recording->seed = Random::getSeed();
+		recording->width = width;
+		recording->height = height;
+	}
+}
+
+void Engine::recordFrame() {
+	if (recording != NULL) {
+		recording->addFrame({ camera.position, camera.rotation });
+	}
+}
+
+/**
+ * Saves the most recently drawn frame to an image file. Only
+ * supported by headless engines, which keep their frames in memory.
+ */
+bool Engine::saveFrame(const char* path) {
+	rasterizer->finish();
+
+	return framebuffer != NULL && framebuffer->save(path);
+}
+
+void Engine::setCullMode(CullMode cullMode) {
+	this->cullMode = cullMode;
 }
 
 void Engine::updateMovement() {
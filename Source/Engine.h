@@ -3,18 +3,79 @@
 #include <SDL.h>
 #include <math.h>
 #include <vector>
+#include <Bvh.h>
 #include <Rasterizer.h>
+#include <RenderTarget.h>
 #include <Objects.h>
+#include <Recording.h>
+#include <Terrain.h>
+#include <VertexProcessor.h>
 
 enum Flags: Uint32 {
 	DEBUG_DRAWTIME = 1 << 0,
-	SHOW_WIREFRAME = 1 << 1
+	SHOW_WIREFRAME = 1 << 1,
+	HEADLESS = 1 << 2,
+	BINNED_RASTERIZATION = 1 << 3,
+	HALF_SPACE_RASTERIZATION = 1 << 4,
+	PIPELINED_PRESENTATION = 1 << 5,
+	COMPACT_DEPTH = 1 << 6,
+	DIRECT_PRESENTATION = 1 << 7,
+	DEPTH_TESTED_WIREFRAME = 1 << 8,
+	DEPTH_PREPASS = 1 << 9,
+	SORTED_TRIANGLES = 1 << 10,
+	FLAT_SHADING = 1 << 11
+};
+
+/**
+ * Which triangles to discard based on their winding order on
+ * screen. Front faces are wound clockwise.
+ */
+enum CullMode {
+	CULL_NONE,
+	CULL_BACK,
+	CULL_FRONT
+};
+
+/**
+ * Counts of the objects and triangles discarded by each culling
+ * stage, reset at the start of every frame.
+ */
+struct CullStatistics {
+	int frustumObjects = 0;
+	int occludedObjects = 0;
+	int nearPlaneTriangles = 0;
+	int offScreenTriangles = 0;
+	int degenerateTriangles = 0;
+	int facingTriangles = 0;
+	int subpixelTriangles = 0;
+	int occludedTriangles = 0;
+	int drawnTriangles = 0;
 };
 
 struct Camera {
 	Vec3 position = { 0, 100, 0 };
 	Vec3 rotation = { 0, 0, 0 };
 	int fov = 90;
+	float nearDistance = 1.0f;
+	float farDistance = 100000.0f;
+};
+
+/**
+ * A vertex after transformation and projection, cached for
+ * each of the polygons sharing it.
+ */
+struct TransformedVertex {
+	Vertex2d vertex;
+	bool isInView;
+};
+
+/**
+ * A visible object, along with the view-space depth of the nearest
+ * point of its bounding sphere, which objects are drawn in order of.
+ */
+struct SortedObject {
+	Object* object;
+	float depth;
 };
 
 struct Movement {
@@ -27,26 +88,58 @@ class Engine {
 		Engine(int width, int height, Uint32 flags = 0);
 		~Engine();
 		void addObject(Object* object);
+		void addTerrain(Terrain* terrain);
 		void draw();
+		void record(Recording* recording);
+		void replay(const Recording& recording);
 		void run();
+		void run(int totalFrames);
+		bool saveFrame(const char* path);
+		void setCullMode(CullMode cullMode);
 	private:
-		SDL_Window* window;
-		SDL_Renderer* renderer;
+		SDL_Window* window = NULL;
+		RenderTarget* renderTarget;
+		FramebufferTarget* framebuffer = NULL;
 		std::vector<Object*> objects;
+		std::vector<Object*> visibleObjects;
+		std::vector<SortedObject> sortedObjects;
+		std::vector<Terrain*> terrains;
+		Bvh bvh;
+		int totalPolygons = 0;
 		Rasterizer* rasterizer;
+		VertexProcessor vertexProcessor;
+		VertexStream projectedVertices;
+		std::vector<TransformedVertex> transformedVertices;
+		const Texture* objectTexture = NULL;
+		std::vector<Uint8> polygonBuckets;
+		std::vector<int> sortedPolygons;
 		Camera camera;
 		Coordinate lastMouseCoordinate;
 		Vec3 velocity;
 		Movement movement;
 		Uint32 flags = 0;
+		CullMode cullMode = CULL_BACK;
+		CullStatistics cullStatistics;
+		Recording* recording = NULL;
 		constexpr static int MOVEMENT_SPEED = 5;
+		constexpr static int POLYGON_BUCKETS = 32;
 		int width;
 		int height;
+		Frustum createViewFrustum(float focalLength);
 		void delay(int ms);
+		void drawClippedPolygon(Object* object, const ProjectionParameters& projection, const uint32_t* polygon);
+		void drawObject(Object* object, const Matrix4& view, const Matrix4& viewProjection, const Frustum& frustum);
+		void drawPolygon(Object* object, const ProjectionParameters& projection, const uint32_t* polygon);
+		void drawSortedPolygons(Object* object, const ProjectionParameters& projection, int minDepth, int maxDepth);
+		void drawTriangle(Triangle& triangle);
 		int getPolygonCount();
+		const char* getPresentPath();
 		void handleEvent(const SDL_Event& event);
 		void handleKeyDown(const SDL_Keycode& code);
 		void handleKeyUp(const SDL_Keycode& code);
 		void handleMouseMotionEvent(const SDL_MouseMotionEvent& event);
+		void printCullStatistics();
+		void printFrameTimings(std::vector<double>& frameTimes);
+		void recordFrame();
 		void updateMovement();
 };
\ No newline at end of file
@@ -10,8 +10,9 @@ inline int lerp(int v1, int v2, float ratio) {
 
 inline Color lerp(const Color& c1, const Color& c2, float ratio) {
 	return {
-		lerp(c1.R, c2.R, ratio),
-		lerp(c1.G, c2.G, ratio),
-		lerp(c1.B, c2.B, ratio)
+		lerp(c1.getR(), c2.getR(), ratio),
+		lerp(c1.getG(), c2.getG(), ratio),
+		lerp(c1.getB(), c2.getB(), ratio),
+		lerp(c1.getA(), c2.getA(), ratio)
 	};
 }
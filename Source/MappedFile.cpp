@@ -0,0 +1,97 @@
+#include <MappedFile.h>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+	#ifdef _WIN32
+		if (data != NULL) {
+			UnmapViewOfFile(data);
+		}
+
+		if (mappingHandle != NULL) {
+			CloseHandle(mappingHandle);
+		}
+
+		if (fileHandle != NULL) {
+			CloseHandle(fileHandle);
+		}
+	#else
+		if (data != NULL) {
+			munmap((void*)data, size);
+		}
+	#endif
+}
+
+const uint8_t* MappedFile::getData() const {
+	return data;
+}
+
+size_t MappedFile::getSize() const {
+	return size;
+}
+
+/**
+ * Maps a file into memory, returning NULL if it can't be opened or
+ * is empty.
+ */
+std::shared_ptr<const MappedFile> MappedFile::open(const char* path) {
+	std::shared_ptr<MappedFile> file(new MappedFile());
+
+	#ifdef _WIN32
+		HANDLE fileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		LARGE_INTEGER fileSize;
+
+		if (fileHandle == INVALID_HANDLE_VALUE) {
+			return NULL;
+		}
+
+		file->fileHandle = fileHandle;
+
+		if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+			return NULL;
+		}
+
+		file->mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+
+		if (file->mappingHandle == NULL) {
+			return NULL;
+		}
+
+		file->data = (const uint8_t*)MapViewOfFile(file->mappingHandle, FILE_MAP_READ, 0, 0, 0);
+		file->size = (size_t)fileSize.QuadPart;
+	#else
+		int descriptor = ::open(path, O_RDONLY);
+		struct stat status;
+
+		if (descriptor < 0) {
+			return NULL;
+		}
+
+		if (fstat(descriptor, &status) != 0 || status.st_size == 0) {
+			close(descriptor);
+			return NULL;
+		}
+
+		void* data = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+
+		// The mapping remains valid after its file descriptor is closed
+		close(descriptor);
+
+		if (data == MAP_FAILED) {
+			return NULL;
+		}
+
+		file->data = (const uint8_t*)data;
+		file->size = status.st_size;
+	#endif
+
+	return file->data != NULL ? file : NULL;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+
+/**
+ * A file mapped read-only into memory. Pages are loaded by the
+ * operating system as they're first touched, and shared with any
+ * other process mapping the same file.
+ */
+class MappedFile {
+	public:
+		~MappedFile();
+		const uint8_t* getData() const;
+		size_t getSize() const;
+		static std::shared_ptr<const MappedFile> open(const char* path);
+	private:
+		const uint8_t* data = NULL;
+		size_t size = 0;
+		#ifdef _WIN32
+			void* fileHandle = NULL;
+			void* mappingHandle = NULL;
+		#endif
+
+		MappedFile() = default;
+};
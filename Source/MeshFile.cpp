@@ -0,0 +1,399 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include <MappedFile.h>
+#include <MeshFile.h>
+
+namespace {
+	constexpr char MAGIC[8] = { 'S', 'O', 'F', 'T', 'M', 'E', 'S', 'H' };
+
+	/**
+	 * The header at the start of every binary mesh file. Offsets are
+	 * in bytes from the start of the file.
+	 */
+	struct MeshFileHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t colorSize;
+		uint32_t uvCount;
+		float boundsMin[3];
+		float boundsMax[3];
+		uint64_t xOffset;
+		uint64_t yOffset;
+		uint64_t zOffset;
+		uint64_t colorOffset;
+		uint64_t uvOffset;
+		uint64_t indexOffset;
+	};
+
+	/**
+	 * A vertex's position, color and texture coordinate, compared bit
+	 * for bit when removing duplicate vertices.
+	 */
+	struct VertexKey {
+		float x;
+		float y;
+		float z;
+		Color color;
+		TextureCoordinate uv;
+
+		bool operator ==(const VertexKey& key) const {
+			return (
+				memcmp(&x, &key.x, sizeof(float)) == 0 &&
+				memcmp(&y, &key.y, sizeof(float)) == 0 &&
+				memcmp(&z, &key.z, sizeof(float)) == 0 &&
+				color == key.color &&
+				memcmp(&uv, &key.uv, sizeof(TextureCoordinate)) == 0
+			);
+		}
+	};
+
+	struct VertexKeyHash {
+		size_t operator ()(const VertexKey& key) const {
+			uint32_t words[6];
+			size_t hash = 0;
+
+			memcpy(&words[0], &key.x, sizeof(float));
+			memcpy(&words[1], &key.y, sizeof(float));
+			memcpy(&words[2], &key.z, sizeof(float));
+			words[3] = key.color.value;
+			memcpy(&words[4], &key.uv.u, sizeof(float));
+			memcpy(&words[5], &key.uv.v, sizeof(float));
+
+			for (uint32_t word : words) {
+				hash = (hash ^ word) * 0x100000001B3ull;
+			}
+
+			return hash;
+		}
+	};
+
+	uint64_t align(uint64_t offset) {
+		return (offset + MeshFile::ALIGNMENT - 1) / MeshFile::ALIGNMENT * MeshFile::ALIGNMENT;
+	}
+
+	bool isArrayInFile(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t fileSize) {
+		return offset % MeshFile::ALIGNMENT == 0 && offset <= fileSize && count * elementSize <= fileSize - offset;
+	}
+
+	const char* skipSpaces(const char* c) {
+		while (*c == ' ' || *c == '\t') {
+			c++;
+		}
+
+		return c;
+	}
+
+	bool readFile(const char* path, std::vector<char>& contents) {
+		FILE* file = fopen(path, "rb");
+
+		if (file == NULL) {
+			return false;
+		}
+
+		fseek(file, 0, SEEK_END);
+		long size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+
+		contents.resize(size > 0 ? size + 1 : 1);
+
+		bool isRead = size >= 0 && fread(contents.data(), 1, size, file) == (size_t)size;
+
+		contents.back() = '\0';
+		fclose(file);
+
+		return isRead;
+	}
+}
+
+/**
+ * Imports the vertices and faces of an OBJ file. Vertex colors are
+ * read from the common "v x y z r g b" extension, and default to
+ * white. Faces with more than three vertices are split into fans of
+ * triangles. Files defining any texture coordinates import as
+ * textured meshes, placing face vertices given no texture coordinate
+ * at the texture's top left corner. Normals are ignored, so vertices
+ * which only differ by them are merged, along with any other vertices
+ * sharing a position, color and texture coordinate.
+ *
+ * OBJ files are right-handed, whereas the engine's space is
+ * left-handed, so z is negated and faces are rewound to keep their
+ * front faces pointing outward. OBJ texture coordinates start from
+ * the bottom of the texture, so they're flipped vertically. Returns
+ * NULL if the file can't be read, or refers to vertices or texture
+ * coordinates it doesn't define.
+ */
+std::shared_ptr<MeshResource> MeshFile::importObj(const char* path) {
+	std::vector<char> contents;
+
+	if (!readFile(path, contents)) {
+		return NULL;
+	}
+
+	std::vector<VertexKey> objVertices;
+	std::vector<TextureCoordinate> objUvs;
+	std::vector<VertexKey> faceVertices;
+	std::vector<VertexKey> polygon;
+	const char* c = contents.data();
+
+	while (*c != '\0') {
+		c = skipSpaces(c);
+
+		if (c[0] == 'v' && (c[1] == ' ' || c[1] == '\t')) {
+			float values[6] = { 0, 0, 0, 1, 1, 1 };
+			int totalValues = 0;
+			char* end;
+
+			c += 2;
+
+			while (totalValues < 6) {
+				float value = strtof(c, &end);
+
+				if (end == c) {
+					break;
+				}
+
+				values[totalValues++] = value;
+				c = end;
+			}
+
+			auto toChannel = [](float value) {
+				return std::min(std::max((int)(value * 255 + 0.5f), 0), 255);
+			};
+
+			// Adding zero turns negative zeros positive, so that they're
+			// merged with positive zeros
+			objVertices.push_back({
+				values[0] + 0.0f, values[1] + 0.0f, -values[2] + 0.0f,
+				{ toChannel(values[3]), toChannel(values[4]), toChannel(values[5]) },
+				{ 0.0f, 0.0f }
+			});
+		} else if (c[0] == 'v' && c[1] == 't' && (c[2] == ' ' || c[2] == '\t')) {
+			char* end;
+			float u = strtof(c + 3, &end);
+			float v = strtof(end, &end);
+
+			objUvs.push_back({ u + 0.0f, 1.0f - v + 0.0f });
+		} else if (c[0] == 'f' && (c[1] == ' ' || c[1] == '\t')) {
+			// Indices are one-based, or relative to the end of the
+			// elements defined so far when negative
+			auto toIndex = [](long index, size_t count) {
+				return index > 0 ? index - 1 : (long)count + index;
+			};
+
+			polygon.clear();
+			c += 2;
+
+			while (true) {
+				char* end;
+				long index = toIndex(strtol(c, &end, 10), objVertices.size());
+
+				if (end == c) {
+					break;
+				}
+
+				if (index < 0 || index >= (long)objVertices.size()) {
+					return NULL;
+				}
+
+				VertexKey vertex = objVertices.at(index);
+
+				c = end;
+
+				if (*c == '/' && c[1] != '/') {
+					long uvIndex = toIndex(strtol(c + 1, &end, 10), objUvs.size());
+
+					if (end == c + 1 || uvIndex < 0 || uvIndex >= (long)objUvs.size()) {
+						return NULL;
+					}
+
+					vertex.uv = objUvs.at(uvIndex);
+				}
+
+				polygon.push_back(vertex);
+
+				// Skip any normal index
+				while (*c != '\0' && *c != ' ' && *c != '\t' && *c != '\n' && *c != '\r') {
+					c++;
+				}
+			}
+
+			for (int i = 1; i + 1 < polygon.size(); i++) {
+				faceVertices.push_back(polygon.at(0));
+				faceVertices.push_back(polygon.at(i + 1));
+				faceVertices.push_back(polygon.at(i));
+			}
+		}
+
+		while (*c != '\0' && *c != '\n') {
+			c++;
+		}
+
+		if (*c == '\n') {
+			c++;
+		}
+	}
+
+	// Only vertices used by faces are kept, in the order they're first
+	// used, with duplicates merged
+	std::shared_ptr<MeshResource> mesh = std::make_shared<MeshResource>();
+	std::unordered_map<VertexKey, uint32_t, VertexKeyHash> meshIndices;
+	bool isTextured = !objUvs.empty();
+
+	meshIndices.reserve(objVertices.size());
+
+	for (int i = 0; i < faceVertices.size(); i += 3) {
+		uint32_t polygonIndices[3];
+
+		for (int v = 0; v < 3; v++) {
+			const VertexKey& vertex = faceVertices.at(i + v);
+			auto result = meshIndices.insert({ vertex, (uint32_t)mesh->getVertexCount() });
+
+			if (result.second && isTextured) {
+				mesh->addVertex({ vertex.x, vertex.y, vertex.z }, vertex.color, vertex.uv);
+			} else if (result.second) {
+				mesh->addVertex({ vertex.x, vertex.y, vertex.z }, vertex.color);
+			}
+
+			polygonIndices[v] = result.first->second;
+		}
+
+		mesh->addPolygon(polygonIndices[0], polygonIndices[1], polygonIndices[2]);
+	}
+
+	return mesh;
+}
+
+/**
+ * Maps a binary mesh file saved by save(). Only the header is read,
+ * along with the index buffer, which is checked against the vertex
+ * count so that corrupt files can't cause out of bounds reads. Returns
+ * NULL if the file can't be mapped, or isn't a valid mesh file.
+ */
+std::shared_ptr<const MeshResource> MeshFile::load(const char* path) {
+	std::shared_ptr<const MappedFile> file = MappedFile::open(path);
+
+	if (file == NULL || file->getSize() < sizeof(MeshFileHeader)) {
+		return NULL;
+	}
+
+	MeshFileHeader header;
+	uint64_t size = file->getSize();
+
+	memcpy(&header, file->getData(), sizeof(header));
+
+	bool isValid = (
+		memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+		header.version == VERSION &&
+		header.colorSize == sizeof(Color) &&
+		(header.uvCount == 0 || header.uvCount == header.vertexCount) &&
+		header.vertexCount <= INT_MAX &&
+		header.indexCount <= INT_MAX &&
+		header.indexCount % 3 == 0 &&
+		isArrayInFile(header.xOffset, header.vertexCount, sizeof(float), size) &&
+		isArrayInFile(header.yOffset, header.vertexCount, sizeof(float), size) &&
+		isArrayInFile(header.zOffset, header.vertexCount, sizeof(float), size) &&
+		isArrayInFile(header.colorOffset, header.vertexCount, sizeof(Color), size) &&
+		isArrayInFile(header.uvOffset, header.uvCount, sizeof(TextureCoordinate), size) &&
+		isArrayInFile(header.indexOffset, header.indexCount, sizeof(uint32_t), size)
+	);
+
+	if (!isValid) {
+		return NULL;
+	}
+
+	const uint8_t* data = file->getData();
+	const uint32_t* indices = (const uint32_t*)(data + header.indexOffset);
+
+	for (uint32_t i = 0; i < header.indexCount; i++) {
+		if (indices[i] >= header.vertexCount) {
+			return NULL;
+		}
+	}
+
+	std::shared_ptr<MeshResource> mesh = std::make_shared<MeshResource>();
+	int vertexCount = header.vertexCount;
+
+	mesh->file = file;
+	mesh->mappedPositions = {
+		(const float*)(data + header.xOffset),
+		(const float*)(data + header.yOffset),
+		(const float*)(data + header.zOffset),
+		vertexCount
+	};
+	mesh->mappedColors = { (const Color*)(data + header.colorOffset), vertexCount };
+	mesh->mappedUvs = { (const TextureCoordinate*)(data + header.uvOffset), (int)header.uvCount };
+	mesh->mappedIndices = { indices, (int)header.indexCount };
+	mesh->bounds.min = { header.boundsMin[0], header.boundsMin[1], header.boundsMin[2] };
+	mesh->bounds.max = { header.boundsMax[0], header.boundsMax[1], header.boundsMax[2] };
+
+	return mesh;
+}
+
+/**
+ * Saves a mesh in the binary format read by load().
+ */
+bool MeshFile::save(const MeshResource& mesh, const char* path) {
+	VertexSpan positions = mesh.getPositions();
+	Span<Color> colors = mesh.getColors();
+	Span<TextureCoordinate> uvs = mesh.getUvs();
+	Span<uint32_t> indices = mesh.getIndices();
+	const BoundingBox& bounds = mesh.getBounds();
+	MeshFileHeader header;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+
+	header.version = VERSION;
+	header.vertexCount = positions.size;
+	header.indexCount = indices.size;
+	header.colorSize = sizeof(Color);
+	header.uvCount = uvs.size;
+	header.boundsMin[0] = bounds.min.x;
+	header.boundsMin[1] = bounds.min.y;
+	header.boundsMin[2] = bounds.min.z;
+	header.boundsMax[0] = bounds.max.x;
+	header.boundsMax[1] = bounds.max.y;
+	header.boundsMax[2] = bounds.max.z;
+	header.xOffset = align(sizeof(header));
+	header.yOffset = align(header.xOffset + positions.size * sizeof(float));
+	header.zOffset = align(header.yOffset + positions.size * sizeof(float));
+	header.colorOffset = align(header.zOffset + positions.size * sizeof(float));
+	header.uvOffset = align(header.colorOffset + positions.size * sizeof(Color));
+	header.indexOffset = align(header.uvOffset + uvs.size * sizeof(TextureCoordinate));
+
+	FILE* file = fopen(path, "wb");
+
+	if (file == NULL) {
+		return false;
+	}
+
+	const uint8_t padding[ALIGNMENT] = { };
+	uint64_t offset = 0;
+
+	auto write = [&](uint64_t arrayOffset, const void* data, uint64_t length) {
+		fwrite(padding, 1, arrayOffset - offset, file);
+		fwrite(data, 1, length, file);
+
+		offset = arrayOffset + length;
+	};
+
+	write(0, &header, sizeof(header));
+	write(header.xOffset, positions.x, positions.size * sizeof(float));
+	write(header.yOffset, positions.y, positions.size * sizeof(float));
+	write(header.zOffset, positions.z, positions.size * sizeof(float));
+	write(header.colorOffset, colors.data, colors.size * sizeof(Color));
+	write(header.uvOffset, uvs.data, uvs.size * sizeof(TextureCoordinate));
+	write(header.indexOffset, indices.data, indices.size * sizeof(uint32_t));
+
+	bool isWritten = ferror(file) == 0;
+
+	return fclose(file) == 0 && isWritten;
+}
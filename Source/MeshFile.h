@@ -0,0 +1,27 @@
+#pragma once
+
+#include <memory>
+#include <Objects.h>
+
+/**
+ * Imports meshes from Wavefront OBJ files, and stores them in a
+ * preprocessed binary format which loads without any parsing.
+ *
+ * Binary mesh files hold a fixed-size header, followed by the x, y
+ * and z coordinates of every vertex, their packed 32-bit colors,
+ * their texture coordinates if the mesh has any, and the index
+ * buffer, each as a separate array aligned to ALIGNMENT bytes, in the
+ * byte order of the machine which saved them. Loaded meshes view the
+ * arrays straight out of the mapped file. Loading reads every index
+ * once, to check it against the vertex count, but never touches the
+ * vertex arrays, whose pages are only read from disk as they're drawn.
+ */
+class MeshFile {
+	public:
+		constexpr static int VERSION = 3;
+		constexpr static int ALIGNMENT = 64;
+
+		static std::shared_ptr<MeshResource> importObj(const char* path);
+		static std::shared_ptr<const MeshResource> load(const char* path);
+		static bool save(const MeshResource& mesh, const char* path);
+};
@@ -1,57 +1,222 @@
+#include <Bvh.h>
 #include <Objects.h>
+#include <Random.h>
 
-Object::Object() {}
+void MeshResource::addPolygon(uint32_t v1, uint32_t v2, uint32_t v3) {
+    indices.push_back(v1);
+    indices.push_back(v2);
+    indices.push_back(v3);
+}
 
-Object::~Object() {
-    polygons.clear();
-    vertices.clear();    
+void MeshResource::addVertex(const Vec3& vector, const Color& color) {
+    if (positions.size() == 0) {
+        bounds.min = bounds.max = vector;
+    } else {
+        bounds.min = { std::min(bounds.min.x, vector.x), std::min(bounds.min.y, vector.y), std::min(bounds.min.z, vector.z) };
+        bounds.max = { std::max(bounds.max.x, vector.x), std::max(bounds.max.y, vector.y), std::max(bounds.max.z, vector.z) };
+    }
+
+    positions.push(vector);
+    colors.push_back(color);
+}
+
+void MeshResource::addVertex(const Vec3& vector, const Color& color, const TextureCoordinate& uv) {
+    addVertex(vector, color);
+
+    uvs.push_back(uv);
 }
 
-void Object::forEachPolygon(std::function<void(const Polygon&)> handle) {
-    for (int i = 0; i < polygons.size(); i++) {
-        handle(polygons.at(i));
+/**
+ * Returns the bounding box of the mesh's vertices, in model space.
+ */
+const BoundingBox& MeshResource::getBounds() const {
+    return bounds;
+}
+
+Span<Color> MeshResource::getColors() const {
+    if (file != NULL && colors.empty()) {
+        return mappedColors;
     }
+
+    return { colors.data(), (int)colors.size() };
+}
+
+Span<uint32_t> MeshResource::getIndices() const {
+    return file != NULL ? mappedIndices : Span<uint32_t> { indices.data(), (int)indices.size() };
+}
+
+VertexSpan MeshResource::getPositions() const {
+    return file != NULL ? mappedPositions : positions.getSpan();
+}
+
+/**
+ * Returns the texture coordinate of every vertex, or nothing if the
+ * mesh can't be textured.
+ */
+Span<TextureCoordinate> MeshResource::getUvs() const {
+    return file != NULL ? mappedUvs : Span<TextureCoordinate> { uvs.data(), (int)uvs.size() };
+}
+
+int MeshResource::getVertexCount() const {
+    return file != NULL ? mappedPositions.size : positions.size();
+}
+
+void MeshResource::setColors(const std::vector<Color>& colors) {
+    this->colors = colors;
+}
+
+Object::Object() {
+    mesh = std::make_shared<MeshResource>();
+}
+
+Object::Object(std::shared_ptr<const MeshResource> mesh) {
+    this->mesh = mesh;
+}
+
+Object::~Object() {
+    if (bvh != NULL) {
+        bvh->remove(this);
+    }
+}
+
+/**
+ * Returns the bounding box of the object's mesh, in model space.
+ */
+const BoundingBox& Object::getBounds() {
+    return mesh->getBounds();
+}
+
+Span<Color> Object::getColors() {
+    return mesh->getColors();
+}
+
+Span<uint32_t> Object::getIndices() {
+    return mesh->getIndices();
+}
+
+const std::shared_ptr<const MeshResource>& Object::getMesh() {
+    return mesh;
 }
 
 int Object::getPolygonCount() {
-    return polygons.size();
+    return getIndices().size / 3;
 }
 
-void Object::rotate(const Vec3& rotation) {
-    RotationMatrix rotationMatrix = RotationMatrix::calculate(rotation);
+const Vec3& Object::getPosition() {
+    return position;
+}
+
+VertexSpan Object::getPositions() {
+    return mesh->getPositions();
+}
+
+float Object::getScale() {
+    return scale;
+}
+
+const std::shared_ptr<const Texture>& Object::getTexture() {
+    return texture;
+}
+
+/**
+ * Returns the matrix applying the object's scale, then its rotation,
+ * to model-space vertices. The object's position is added after.
+ */
+RotationMatrix Object::getTransform() {
+    return rotation * scale;
+}
 
-    for (int i = 0; i < vertices.size(); i++) {
-        vertices.at(i).vector.rotate(rotationMatrix);
+Span<TextureCoordinate> Object::getUvs() {
+    return mesh->getUvs();
+}
+
+int Object::getVertexCount() {
+    return mesh->getVertexCount();
+}
+
+/**
+ * Returns the world-space axis-aligned box containing the object's
+ * transformed model-space bounds.
+ */
+const BoundingBox& Object::getWorldBounds() {
+    if (hasStaleWorldBounds) {
+        const BoundingBox& bounds = mesh->getBounds();
+        RotationMatrix transform = getTransform();
+        Vec3 center = position + transform * bounds.getCenter();
+        Vec3 extents = (bounds.max - bounds.min) * 0.5f;
+
+        Vec3 worldExtents = {
+            std::abs(transform.m11) * extents.x + std::abs(transform.m12) * extents.y + std::abs(transform.m13) * extents.z,
+            std::abs(transform.m21) * extents.x + std::abs(transform.m22) * extents.y + std::abs(transform.m23) * extents.z,
+            std::abs(transform.m31) * extents.x + std::abs(transform.m32) * extents.y + std::abs(transform.m33) * extents.z
+        };
+
+        worldBounds = { center - worldExtents, center + worldExtents };
+        hasStaleWorldBounds = false;
     }
+
+    return worldBounds;
+}
+
+/**
+ * Rotates the object further by the given Euler angles.
+ */
+void Object::rotate(const Vec3& rotation) {
+    this->rotation = RotationMatrix::calculate(rotation) * this->rotation;
+
+    markDirty();
+}
+
+void Object::setMesh(std::shared_ptr<const MeshResource> mesh) {
+    this->mesh = mesh;
+
+    markDirty();
+}
+
+void Object::setPosition(const Vec3& position) {
+    this->position = position;
+
+    markDirty();
 }
 
-void Object::addPolygon(Vertex3d* v1, Vertex3d* v2, Vertex3d* v3) {
-    Polygon polygon;
+void Object::setRotation(const Vec3& rotation) {
+    this->rotation = RotationMatrix::calculate(rotation);
+
+    markDirty();
+}
 
-    polygon.bindVertex(0, v1);
-    polygon.bindVertex(1, v2);
-    polygon.bindVertex(2, v3);
+/**
+ * Sets the object's uniform scale, which must be positive to
+ * preserve the winding order of its polygons.
+ */
+void Object::setScale(float scale) {
+    this->scale = scale;
 
-    polygons.push_back(polygon);
+    markDirty();
 }
 
-void Object::addVertex(const Vec3& vector, const Color& color) {
-    Vertex3d vertex;
+void Object::setTexture(std::shared_ptr<const Texture> texture) {
+    this->texture = texture;
+}
 
-    vertex.vector = vector;
-    vertex.color = color;
+void Object::markDirty() {
+    hasStaleWorldBounds = true;
 
-    vertices.push_back(vertex);
+    if (bvh != NULL) {
+        bvh->markDirty(this);
+    }
 }
 
 Mesh::Mesh(int rows, int columns, float tileSize) {
+    std::shared_ptr<MeshResource> mesh = std::make_shared<MeshResource>();
+
     // Vertex creation
     int verticesPerRow = columns + 1;
     int verticesPerColumn = rows + 1;
 
     for (int z = 0; z < verticesPerColumn; z++) {
         for (int x = 0; x < verticesPerRow; x++) {
-            addVertex({ x * tileSize, (float)(rand() % 50), z * tileSize }, { 255, 255, 255 });
+            mesh->addVertex({ x * tileSize, (float)Random::nextInt(50), z * tileSize }, { 255, 255, 255 });
         }
     }
 
@@ -67,7 +232,8 @@ Mesh::Mesh(int rows, int columns, float tileSize) {
     // The vertices of a polygon can be computed from its index in a particular
     // row. 'Lower' polygons are defined as those on the bottom right of any
     // given tile (i.e., evenly-numbered polygons). Once we reach the end of
-    // a row, we move to the next until we run out of rows.
+    // a row, we move to the next until we run out of rows. Both kinds of
+    // polygon are wound with their front faces pointing up.
     int polygonsPerRow = 2 * columns;
 
     for (int row = 0; row < rows; row++) {
@@ -75,48 +241,126 @@ Mesh::Mesh(int rows, int columns, float tileSize) {
             bool isLowerPolygon = p % 2 == 0;
             int firstVertexIndex = row * verticesPerRow + (int)p / 2;
 
-            addPolygon(
-                &vertices.at(firstVertexIndex),
-                &vertices.at(isLowerPolygon ? firstVertexIndex + verticesPerRow - 1 : firstVertexIndex + 1),
-                &vertices.at(firstVertexIndex + verticesPerRow)
-            );
+            if (isLowerPolygon) {
+                mesh->addPolygon(firstVertexIndex, firstVertexIndex + verticesPerRow - 1, firstVertexIndex + verticesPerRow);
+            } else {
+                mesh->addPolygon(firstVertexIndex, firstVertexIndex + verticesPerRow, firstVertexIndex + 1);
+            }
         }
     }
+
+    setMesh(mesh);
 }
 
+/**
+ * Recolors the mesh. Since resources are immutable, this replaces
+ * the mesh with a recolored copy.
+ */
 void Mesh::setColor(int R, int G, int B) {
-    for (int i = 0; i < vertices.size(); i++) {
-        // vertices.at(i).color = { R, G, B };
-        vertices.at(i).color = { rand() % 255, rand() % 255, rand() % 255 };
+    std::shared_ptr<MeshResource> mesh = std::make_shared<MeshResource>(*getMesh());
+    std::vector<Color> colors(mesh->getVertexCount());
+
+    for (int i = 0; i < colors.size(); i++) {
+        // colors.at(i) = { R, G, B };
+        colors.at(i) = { Random::nextInt(255), Random::nextInt(255), Random::nextInt(255) };
     }
+
+    mesh->setColors(colors);
+
+    setMesh(mesh);
 }
 
 void Mesh::setColor(const Color& color) {
-    setColor(color.R, color.G, color.B);
+    setColor(color.getR(), color.getG(), color.getB());
 }
 
-Cube::Cube(float radius) {
-    float diameter = 2 * radius;
+Cube::Cube(float radius) : Object(getUnitCube()) {
+    setScale(radius);
+}
+
+Cube::Cube(float radius, std::shared_ptr<const Texture> texture) : Object(texture != NULL ? getTexturedUnitCube() : getUnitCube()) {
+    setScale(radius);
+    setTexture(texture);
+}
+
+/**
+ * Creates the textured unit cube from the untextured one, giving each
+ * face its own copies of its four corners, colored the same as the
+ * untextured cube's. Texture coordinates are the corners' positions
+ * along the two axes the face spans.
+ */
+std::shared_ptr<const MeshResource> Cube::getTexturedUnitCube() {
+    static std::shared_ptr<const MeshResource> texturedUnitCube = [] {
+        std::shared_ptr<const MeshResource> unitCube = getUnitCube();
+        std::shared_ptr<MeshResource> mesh = std::make_shared<MeshResource>();
+        VertexSpan positions = unitCube->getPositions();
+        Span<Color> colors = unitCube->getColors();
+
+        // Consecutive pairs of polygons make up each face
+        for (int face = 0; face < 6; face++) {
+            const int (*polygons)[3] = &CubeVertices::vertexMap[face * 2];
+            int faceVertices[8] = { -1, -1, -1, -1, -1, -1, -1, -1 };
+            uint32_t first = polygons[0][0];
+            uint32_t second = polygons[1][1];
+            bool isXFace = positions.x[first] == positions.x[second];
+            bool isYFace = positions.y[first] == positions.y[second];
+
+            for (int p = 0; p < 2; p++) {
+                uint32_t polygonIndices[3];
 
-    for (int i = 0; i < 2; i++) {
-        for (int j = 0; j < 4; j++) {
-            Vec3 vector;
+                for (int i = 0; i < 3; i++) {
+                    int v = polygons[p][i];
 
-            vector.x = (j == 2 || j == 3 ? diameter : 0) - radius;
-            vector.y = (i * diameter) - radius;
-            vector.z = (j == 1 || j == 2 ? diameter : 0) - radius;
+                    if (faceVertices[v] < 0) {
+                        float horizontal = isXFace ? positions.z[v] : positions.x[v];
+                        float vertical = isYFace ? positions.z[v] : positions.y[v];
 
-            addVertex(vector, { rand() % 255, rand() % 255, rand() % 255 });
+                        faceVertices[v] = mesh->getVertexCount();
+
+                        mesh->addVertex({ positions.x[v], positions.y[v], positions.z[v] }, colors[v], { (horizontal + 1) / 2, (1 - vertical) / 2 });
+                    }
+
+                    polygonIndices[i] = faceVertices[v];
+                }
+
+                mesh->addPolygon(polygonIndices[0], polygonIndices[1], polygonIndices[2]);
+            }
         }
-    }
 
-    for (int p = 0; p < 12; p++) {
-        const int (*polygonVertices)[3] = &(CubeVertices::vertexMap[p]);
+        return mesh;
+    }();
 
-        addPolygon(
-        	&vertices.at((*polygonVertices)[0]),
-        	&vertices.at((*polygonVertices)[1]),
-        	&vertices.at((*polygonVertices)[2])
-        );
-    }
-}
\ No newline at end of file
+    return texturedUnitCube;
+}
+
+std::shared_ptr<const MeshResource> Cube::getUnitCube() {
+    static std::shared_ptr<const MeshResource> unitCube = [] {
+        std::shared_ptr<MeshResource> mesh = std::make_shared<MeshResource>();
+
+        for (int i = 0; i < 2; i++) {
+            for (int j = 0; j < 4; j++) {
+                Vec3 vector;
+
+                vector.x = j == 2 || j == 3 ? 1 : -1;
+                vector.y = i == 1 ? 1 : -1;
+                vector.z = j == 1 || j == 2 ? 1 : -1;
+
+                mesh->addVertex(vector, { Random::nextInt(255), Random::nextInt(255), Random::nextInt(255) });
+            }
+        }
+
+        for (int p = 0; p < 12; p++) {
+            const int (*polygonVertices)[3] = &(CubeVertices::vertexMap[p]);
+
+            mesh->addPolygon(
+                (*polygonVertices)[0],
+                (*polygonVertices)[1],
+                (*polygonVertices)[2]
+            );
+        }
+
+        return mesh;
+    }();
+
+    return unitCube;
+}
@@ -1,28 +1,103 @@
 #pragma once
-#include <functional>
+#include <stdint.h>
+#include <memory>
 #include <vector>
 #include <algorithm>
+#include <MappedFile.h>
+#include <Texture.h>
 #include <Types.h>
 
-struct Object {
+class Bvh;
+
+/**
+ * Immutable model-space geometry, which any number of objects can
+ * share: structure-of-arrays vertex positions and colors, plus an
+ * index buffer holding three vertex indices per polygon. Resources
+ * are built with addVertex() and addPolygon(), then shared through
+ * a pointer to const. Resources loaded by MeshFile view the arrays
+ * of a mapped file instead, until setColors() replaces its colors.
+ * Meshes which can be textured give every vertex a texture
+ * coordinate, while other meshes give none.
+ */
+struct MeshResource {
 	public:
-		Vec3 position;
+		void addPolygon(uint32_t v1, uint32_t v2, uint32_t v3);
+		void addVertex(const Vec3& vector, const Color& color);
+		void addVertex(const Vec3& vector, const Color& color, const TextureCoordinate& uv);
+		const BoundingBox& getBounds() const;
+		Span<Color> getColors() const;
+		Span<uint32_t> getIndices() const;
+		VertexSpan getPositions() const;
+		Span<TextureCoordinate> getUvs() const;
+		int getVertexCount() const;
+		void setColors(const std::vector<Color>& colors);
+
+	private:
+		friend class MeshFile;
+
+		VertexStream positions;
+		std::vector<Color> colors;
+		std::vector<uint32_t> indices;
+		std::vector<TextureCoordinate> uvs;
+		BoundingBox bounds;
+		std::shared_ptr<const MappedFile> file;
+		VertexSpan mappedPositions;
+		Span<Color> mappedColors;
+		Span<uint32_t> mappedIndices;
+		Span<TextureCoordinate> mappedUvs;
+};
 
+/**
+ * An instance of a mesh resource, placed in the world by its own
+ * position, rotation and uniform scale. The transform is applied as
+ * vertices are projected, so transforming an object never touches
+ * its geometry. Objects added to a Bvh notify it whenever their
+ * transforms change. Objects which only draw part of their geometry,
+ * e.g. at reduced levels of detail, override getIndices() to choose
+ * the polygons drawn, and getVertexCount() to limit the vertices
+ * transformed to a prefix of their positions. Objects with a texture
+ * are drawn textured if their mesh has texture coordinates.
+ */
+struct Object {
+	public:
 		Object();
-		~Object();
+		Object(std::shared_ptr<const MeshResource> mesh);
+		virtual ~Object();
 		
-		void forEachPolygon(std::function<void(const Polygon&)> handle);
+		const BoundingBox& getBounds();
+		Span<Color> getColors();
+		virtual Span<uint32_t> getIndices();
+		const std::shared_ptr<const MeshResource>& getMesh();
 		int getPolygonCount();
+		const Vec3& getPosition();
+		VertexSpan getPositions();
+		float getScale();
+		const std::shared_ptr<const Texture>& getTexture();
+		RotationMatrix getTransform();
+		Span<TextureCoordinate> getUvs();
+		virtual int getVertexCount();
+		const BoundingBox& getWorldBounds();
 		void rotate(const Vec3& rotation);
+		void setMesh(std::shared_ptr<const MeshResource> mesh);
+		void setPosition(const Vec3& position);
+		void setRotation(const Vec3& rotation);
+		void setScale(float scale);
+		void setTexture(std::shared_ptr<const Texture> texture);
 
-	protected:
-		std::vector<Vertex3d> vertices;
+	private:
+		friend class Bvh;
 
-		void addPolygon(Vertex3d* v1, Vertex3d* v2, Vertex3d* v3);
-		void addVertex(const Vec3& vector, const Color& color);
+		std::shared_ptr<const MeshResource> mesh;
+		std::shared_ptr<const Texture> texture;
+		Vec3 position;
+		RotationMatrix rotation = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+		float scale = 1.0f;
+		BoundingBox worldBounds;
+		bool hasStaleWorldBounds = true;
+		Bvh* bvh = NULL;
+		int bvhLeaf = 0;
 
-	private:
-		std::vector<Polygon> polygons;
+		void markDirty();
 };
 
 struct Mesh : Object {
@@ -33,24 +108,37 @@ struct Mesh : Object {
 };
 
 namespace CubeVertices {
+	// Polygons are wound so that (v2 - v1) x (v3 - v1) points out
+	// of the cube, which makes them clockwise on screen when their
+	// front faces are visible
 	constexpr static int vertexMap[12][3] = {
 		{ 0, 1, 4 },
-		{ 1, 4, 5 },
+		{ 1, 5, 4 },
 		{ 1, 2, 5 },
-		{ 2, 5, 6 },
+		{ 2, 6, 5 },
 		{ 2, 3, 6 },
-		{ 3, 6, 7 },
+		{ 3, 7, 6 },
 		{ 3, 0, 7 },
 		{ 0, 4, 7 },
-		{ 0, 2, 3 },
-		{ 0, 1, 2 },
+		{ 0, 3, 2 },
+		{ 0, 2, 1 },
 		{ 4, 5, 6 },
 		{ 4, 6, 7 }
 	};
 };
 
 
+/**
+ * A cube instance. Every cube shares a single unit cube resource,
+ * scaled by the cube's radius. Cubes given a texture share a unit
+ * cube with separate vertices for each face, which maps the whole
+ * texture onto every face.
+ */
 struct Cube : Object {
 	public:
 		Cube(float radius);
+		Cube(float radius, std::shared_ptr<const Texture> texture);
+	private:
+		static std::shared_ptr<const MeshResource> getTexturedUnitCube();
+		static std::shared_ptr<const MeshResource> getUnitCube();
 };
\ No newline at end of file
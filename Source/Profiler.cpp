@@ -0,0 +1,373 @@
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <Profiler.h>
+
+namespace {
+	constexpr const char* STAGE_NAMES[PROFILE_STAGE_COUNT] = {
+		"other", "transform", "cull", "setup", "fill", "clear", "present"
+	};
+
+	constexpr const char* COUNTER_NAMES[PROFILE_COUNTER_COUNT] = {
+		"triangles_submitted", "triangles_culled", "triangles_drawn", "pixels_tested", "pixels_written"
+	};
+
+	// Threads stop recording trace events past this many, bounding
+	// the memory used by long traces
+	constexpr int MAX_TRACE_EVENTS = 1 << 20;
+
+	struct TraceEvent {
+		const char* name;
+		ProfileStage stage;
+		Uint64 startTime;
+		Uint64 duration;
+	};
+
+	/**
+	 * Running totals recorded by a single thread. Totals are only ever
+	 * written by their own thread, and read by the thread ending each
+	 * frame, which takes the difference from the totals it last read.
+	 */
+	struct ThreadProfile {
+		int id;
+		std::atomic<Uint64> stageTicks[PROFILE_STAGE_COUNT];
+		std::atomic<long long> counters[PROFILE_COUNTER_COUNT];
+		Uint64 lastStageTicks[PROFILE_STAGE_COUNT] = { };
+		long long lastCounters[PROFILE_COUNTER_COUNT] = { };
+		std::vector<TraceEvent> events;
+		ProfileScope* currentScope = NULL;
+
+		ThreadProfile(int id) : id(id) {
+			for (auto& ticks : stageTicks) {
+				ticks.store(0, std::memory_order_relaxed);
+			}
+
+			for (auto& counter : counters) {
+				counter.store(0, std::memory_order_relaxed);
+			}
+		}
+	};
+
+	struct FrameEvent {
+		Uint64 time;
+		FrameProfile profile;
+	};
+
+	std::mutex threadMutex;
+	std::vector<std::unique_ptr<ThreadProfile>> threadProfiles;
+	thread_local ThreadProfile* threadProfile = NULL;
+	std::atomic<bool> isTracing { false };
+	Uint64 lastFrameTime = 0;
+	FrameProfile history[Profiler::HISTORY_SIZE];
+	FrameProfile average;
+	int totalFrames = 0;
+	int screenPixels = 1;
+	std::vector<FrameEvent> frameEvents;
+	FILE* csvFile = NULL;
+
+	/**
+	 * Returns the time trace events are relative to, which is the
+	 * first time it's asked for.
+	 */
+	Uint64 getStartTime() {
+		static Uint64 startTime = Profiler::now();
+
+		return startTime;
+	}
+
+	ThreadProfile* getThreadProfile() {
+		if (threadProfile == NULL) {
+			std::lock_guard<std::mutex> lock(threadMutex);
+
+			threadProfiles.emplace_back(new ThreadProfile(threadProfiles.size()));
+			threadProfile = threadProfiles.back().get();
+		}
+
+		return threadProfile;
+	}
+
+	template<typename T>
+	void add(std::atomic<T>& total, T amount) {
+		total.store(total.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+	}
+
+	double toMilliseconds(Uint64 time) {
+		return time / 1.0e6;
+	}
+
+	double toMicroseconds(Uint64 time) {
+		return time / 1.0e3;
+	}
+
+	double toTraceTime(Uint64 time) {
+		return (long long)(time - getStartTime()) / 1.0e3;
+	}
+}
+
+ProfileScope::ProfileScope(ProfileStage stage, const char* name) {
+	ThreadProfile* profile = getThreadProfile();
+
+	this->stage = stage;
+	this->name = name;
+	parent = profile->currentScope;
+	profile->currentScope = this;
+	startTime = Profiler::now();
+}
+
+ProfileScope::~ProfileScope() {
+	Uint64 duration = Profiler::now() - startTime;
+	ThreadProfile* profile = threadProfile;
+
+	add(profile->stageTicks[stage], duration - childTime);
+
+	if (parent != NULL) {
+		parent->childTime += duration;
+	}
+
+	profile->currentScope = parent;
+
+	if (name != NULL && isTracing.load(std::memory_order_relaxed) && profile->events.size() < MAX_TRACE_EVENTS) {
+		profile->events.push_back({ name, stage, startTime, duration });
+	}
+}
+
+void Profiler::count(ProfileCounter counter, long long amount) {
+	add(getThreadProfile()->counters[counter], amount);
+}
+
+/**
+ * Ends the current frame, collecting the time and counts recorded by
+ * every thread since the last frame ended. Time recorded by threads
+ * still working on an earlier frame, e.g. one being presented, is
+ * counted towards the frame it's collected in.
+ */
+void Profiler::endFrame() {
+	Uint64 time = now();
+	FrameProfile frame;
+
+	frame.frameTime = toMilliseconds(time - (lastFrameTime > 0 ? lastFrameTime : getStartTime()));
+	lastFrameTime = time;
+
+	{
+		std::lock_guard<std::mutex> lock(threadMutex);
+
+		for (auto& profile : threadProfiles) {
+			for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+				Uint64 ticks = profile->stageTicks[s].load(std::memory_order_relaxed);
+
+				frame.stageTimes[s] += toMilliseconds(ticks - profile->lastStageTicks[s]);
+				profile->lastStageTicks[s] = ticks;
+			}
+
+			for (int c = 0; c < PROFILE_COUNTER_COUNT; c++) {
+				long long total = profile->counters[c].load(std::memory_order_relaxed);
+
+				frame.counters[c] += total - profile->lastCounters[c];
+				profile->lastCounters[c] = total;
+			}
+		}
+	}
+
+	frame.overdraw = (double)frame.counters[PROFILE_PIXELS_WRITTEN] / screenPixels;
+	history[totalFrames % HISTORY_SIZE] = frame;
+	totalFrames++;
+
+	// Rolling average of the frames in the history
+	int historyFrames = std::min(totalFrames, HISTORY_SIZE);
+
+	average = FrameProfile();
+
+	for (int f = 0; f < historyFrames; f++) {
+		const FrameProfile& profile = history[f];
+
+		average.frameTime += profile.frameTime / historyFrames;
+		average.overdraw += profile.overdraw / historyFrames;
+
+		for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+			average.stageTimes[s] += profile.stageTimes[s] / historyFrames;
+		}
+
+		for (int c = 0; c < PROFILE_COUNTER_COUNT; c++) {
+			average.counters[c] += profile.counters[c];
+		}
+	}
+
+	for (int c = 0; c < PROFILE_COUNTER_COUNT; c++) {
+		average.counters[c] /= historyFrames;
+	}
+
+	if (csvFile != NULL) {
+		fprintf(csvFile, "%d,%.4f", totalFrames - 1, frame.frameTime);
+
+		for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+			fprintf(csvFile, ",%.4f", frame.stageTimes[s]);
+		}
+
+		for (int c = 0; c < PROFILE_COUNTER_COUNT; c++) {
+			fprintf(csvFile, ",%lld", frame.counters[c]);
+		}
+
+		fprintf(csvFile, ",%.4f\n", frame.overdraw);
+	}
+
+	if (isTracing.load(std::memory_order_relaxed) && frameEvents.size() < MAX_TRACE_EVENTS) {
+		frameEvents.push_back({ time, frame });
+	}
+}
+
+/**
+ * Formats the rolling average of recent frames on a single line.
+ * Stage times are summed across threads, so parallel stages can add
+ * up to more than the frame time.
+ */
+void Profiler::formatSummary(char* buffer, int size) {
+	const FrameProfile& frame = average;
+
+	if (!isEnabled()) {
+		snprintf(buffer, size, "Frame: %.2fms, FPS: %.1f", frame.frameTime, frame.frameTime > 0 ? 1000.0 / frame.frameTime : 0.0);
+		return;
+	}
+
+	snprintf(
+		buffer, size,
+		"Frame: %.2fms, FPS: %.1f, Transform: %.2fms, Cull: %.2fms, Setup: %.2fms, Fill: %.2fms, Clear: %.2fms, Present: %.2fms, "
+		"Triangles: %lld/%lld, Pixels tested: %lld, Overdraw: %.2fx",
+		frame.frameTime, frame.frameTime > 0 ? 1000.0 / frame.frameTime : 0.0,
+		frame.stageTimes[PROFILE_TRANSFORM], frame.stageTimes[PROFILE_CULL], frame.stageTimes[PROFILE_SETUP],
+		frame.stageTimes[PROFILE_FILL], frame.stageTimes[PROFILE_CLEAR], frame.stageTimes[PROFILE_PRESENT],
+		frame.counters[PROFILE_TRIANGLES_DRAWN], frame.counters[PROFILE_TRIANGLES_SUBMITTED],
+		frame.counters[PROFILE_PIXELS_TESTED], frame.overdraw
+	);
+}
+
+/**
+ * Returns the rolling average of the last HISTORY_SIZE frames.
+ */
+const FrameProfile& Profiler::getAverage() {
+	return average;
+}
+
+/**
+ * Determines whether stage timings and counters were compiled in.
+ */
+bool Profiler::isEnabled() {
+	#ifdef ENABLE_PROFILER
+		return true;
+	#else
+		return false;
+	#endif
+}
+
+/**
+ * Starts writing a row to a CSV file as each frame ends.
+ */
+bool Profiler::openCsv(const char* path) {
+	if (csvFile != NULL) {
+		fclose(csvFile);
+	}
+
+	csvFile = fopen(path, "w");
+
+	if (csvFile == NULL) {
+		return false;
+	}
+
+	fprintf(csvFile, "frame,frame_ms");
+
+	for (int s = 0; s < PROFILE_STAGE_COUNT; s++) {
+		fprintf(csvFile, ",%s_ms", STAGE_NAMES[s]);
+	}
+
+	for (int c = 0; c < PROFILE_COUNTER_COUNT; c++) {
+		fprintf(csvFile, ",%s", COUNTER_NAMES[c]);
+	}
+
+	fprintf(csvFile, ",overdraw\n");
+
+	return true;
+}
+
+/**
+ * Sets the number of screen pixels, which overdraw is relative to.
+ */
+void Profiler::setScreenSize(int width, int height) {
+	getStartTime();
+
+	screenPixels = std::max(width * height, 1);
+}
+
+/**
+ * Starts recording named scopes and per-frame counters as trace events.
+ */
+void Profiler::startTrace() {
+	getStartTime();
+
+	isTracing = true;
+}
+
+/**
+ * Writes every recorded trace event as a Chrome trace. Must only be
+ * called while no other thread is recording scopes.
+ */
+bool Profiler::writeTrace(const char* path) {
+	FILE* file = fopen(path, "w");
+
+	if (file == NULL) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(threadMutex);
+	bool isFirstEvent = true;
+
+	fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+
+	for (auto& profile : threadProfiles) {
+		for (const TraceEvent& event : profile->events) {
+			fprintf(
+				file, "%s{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %d}",
+				isFirstEvent ? "" : ",\n", event.name, STAGE_NAMES[event.stage],
+				toTraceTime(event.startTime), toMicroseconds(event.duration), profile->id
+			);
+
+			isFirstEvent = false;
+		}
+	}
+
+	for (const FrameEvent& event : frameEvents) {
+		const FrameProfile& frame = event.profile;
+		double time = toTraceTime(event.time);
+
+		fprintf(
+			file, "%s{\"name\": \"triangles\", \"ph\": \"C\", \"ts\": %.3f, \"pid\": 1, \"args\": {\"submitted\": %lld, \"culled\": %lld, \"drawn\": %lld}},\n",
+			isFirstEvent ? "" : ",\n", time, frame.counters[PROFILE_TRIANGLES_SUBMITTED],
+			frame.counters[PROFILE_TRIANGLES_CULLED], frame.counters[PROFILE_TRIANGLES_DRAWN]
+		);
+
+		fprintf(
+			file, "{\"name\": \"pixels\", \"ph\": \"C\", \"ts\": %.3f, \"pid\": 1, \"args\": {\"tested\": %lld, \"written\": %lld}}",
+			time, frame.counters[PROFILE_PIXELS_TESTED], frame.counters[PROFILE_PIXELS_WRITTEN]
+		);
+
+		isFirstEvent = false;
+	}
+
+	fprintf(file, "\n]}\n");
+
+	bool isWritten = ferror(file) == 0;
+
+	return fclose(file) == 0 && isWritten;
+}
+
+/**
+ * Returns a monotonic time in nanoseconds. Scopes read the time twice
+ * each, so this avoids SDL's raw monotonic clock, which may not be
+ * readable without a system call.
+ */
+Uint64 Profiler::now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
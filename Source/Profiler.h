@@ -0,0 +1,96 @@
+#pragma once
+
+#include <SDL.h>
+
+/**
+ * Pipeline stages whose time is measured separately. Scopes measure
+ * exclusive time, so time spent in a nested scope only counts towards
+ * the nested scope's stage. Other time is spent drawing the frame
+ * outside of any of the other stages.
+ */
+enum ProfileStage {
+	PROFILE_OTHER,
+	PROFILE_TRANSFORM,
+	PROFILE_CULL,
+	PROFILE_SETUP,
+	PROFILE_FILL,
+	PROFILE_CLEAR,
+	PROFILE_PRESENT,
+	PROFILE_STAGE_COUNT
+};
+
+enum ProfileCounter {
+	PROFILE_TRIANGLES_SUBMITTED,
+	PROFILE_TRIANGLES_CULLED,
+	PROFILE_TRIANGLES_DRAWN,
+	PROFILE_PIXELS_TESTED,
+	PROFILE_PIXELS_WRITTEN,
+	PROFILE_COUNTER_COUNT
+};
+
+/**
+ * The time spent in each stage during a frame, summed across every
+ * thread, and the counters accumulated during it. Times are in
+ * milliseconds. Overdraw is the number of pixels written per screen
+ * pixel.
+ */
+struct FrameProfile {
+	double frameTime = 0.0;
+	double stageTimes[PROFILE_STAGE_COUNT] = { };
+	long long counters[PROFILE_COUNTER_COUNT] = { };
+	double overdraw = 0.0;
+};
+
+/**
+ * Measures the time spent in a stage for as long as it's in scope,
+ * and records it as a trace event if it's named.
+ */
+class ProfileScope {
+	public:
+		ProfileScope(ProfileStage stage, const char* name);
+		~ProfileScope();
+	private:
+		ProfileStage stage;
+		const char* name;
+		Uint64 startTime;
+		Uint64 childTime = 0;
+		ProfileScope* parent;
+};
+
+/**
+ * Collects stage timings and counters from every thread, and
+ * summarizes them per frame. Frames end whenever endFrame() is
+ * called, and the last HISTORY_SIZE frames are averaged into a
+ * rolling summary. Frames can also be written to a CSV file as they
+ * end, and timings recorded as a Chrome trace (chrome://tracing).
+ *
+ * Building without ENABLE_PROFILER compiles every scope and counter
+ * out, leaving only frame times.
+ */
+class Profiler {
+	public:
+		constexpr static int HISTORY_SIZE = 60;
+
+		static void count(ProfileCounter counter, long long amount);
+		static void endFrame();
+		static void formatSummary(char* buffer, int size);
+		static const FrameProfile& getAverage();
+		static bool isEnabled();
+		static Uint64 now();
+		static bool openCsv(const char* path);
+		static void setScreenSize(int width, int height);
+		static void startTrace();
+		static bool writeTrace(const char* path);
+};
+
+#ifdef ENABLE_PROFILER
+	#define PROFILE_CONCAT_INNER(a, b) a##b
+	#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+	#define PROFILE_SCOPE(stage, name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(stage, name)
+	#define PROFILE_STAGE(stage) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(stage, NULL)
+	#define PROFILE_COUNT(counter, amount) Profiler::count(counter, amount)
+#else
+	#define PROFILE_SCOPE(stage, name)
+	#define PROFILE_STAGE(stage)
+	#define PROFILE_COUNT(counter, amount) ((void)(amount))
+#endif
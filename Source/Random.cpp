@@ -0,0 +1,36 @@
+#include <random>
+
+#include <Random.h>
+
+namespace {
+	// The Mersenne Twister's output is defined exactly by the standard,
+	// whereas its distributions are left to each implementation
+	std::mt19937 generator(Random::DEFAULT_SEED);
+	uint32_t currentSeed = Random::DEFAULT_SEED;
+}
+
+uint32_t Random::getSeed() {
+	return currentSeed;
+}
+
+/**
+ * Returns a random number in [min, max).
+ */
+float Random::nextFloat(float min, float max) {
+	return min + (max - min) * (float)(generator() / 4294967296.0);
+}
+
+/**
+ * Returns a random integer in [0, range).
+ */
+int Random::nextInt(int range) {
+	return generator() % range;
+}
+
+/**
+ * Restarts the sequence of random numbers from a seed.
+ */
+void Random::seed(uint32_t seed) {
+	generator.seed(seed);
+	currentSeed = seed;
+}
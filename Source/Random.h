@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * The random number generator scene content is generated from. Unlike
+ * rand(), its sequence is fully determined by its seed on every
+ * platform, so scenes built in the same order after seeding it with
+ * the same value are identical.
+ */
+class Random {
+	public:
+		constexpr static uint32_t DEFAULT_SEED = 1;
+
+		static uint32_t getSeed();
+		static float nextFloat(float min, float max);
+		static int nextInt(int range);
+		static void seed(uint32_t seed);
+};
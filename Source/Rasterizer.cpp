@@ -4,38 +4,574 @@
 #include <limits.h>
 
 #include <Helpers.h>
+#include <Profiler.h>
 #include <Rasterizer.h>
+#include <Texture.h>
 
-Rasterizer::Rasterizer(SDL_Renderer* renderer, int width, int height) {
+namespace {
+	/**
+	 * Full precision depths, stored as-is.
+	 */
+	struct Depth32 {
+		typedef int Value;
+
+		constexpr static Value CLEAR = INT_MAX;
+
+		static Value encode(int depth) {
+			return depth;
+		}
+
+		static int decode(Value value) {
+			return value;
+		}
+	};
+
+	/**
+	 * Depths stored in 16 bits, keeping the top bits of the full
+	 * DEPTH_BITS range between the near and far planes. The clear value
+	 * is reserved, so every drawn depth passes the depth test against
+	 * it. Decoding rounds up, which keeps tile maxima conservative.
+	 */
+	struct Depth16 {
+		typedef Uint16 Value;
+
+		constexpr static int SHIFT = DEPTH_BITS - 16;
+		constexpr static Value CLEAR = 0xFFFF;
+
+		static Value encode(int depth) {
+			return (Value)std::min(std::max(depth >> SHIFT, 0), CLEAR - 1);
+		}
+
+		static int decode(Value value) {
+			return value == CLEAR ? INT_MAX : (value << SHIFT) | ((1 << SHIFT) - 1);
+		}
+	};
+
+	/**
+	 * A combination of depth test, depth writes and shading, which the
+	 * pixel loops are specialized for. Depths are only computed when
+	 * they're tested or written, and colors only when pixels are shaded.
+	 */
+	template<DepthTest TEST, bool IS_WRITTEN, Shading SHADE>
+	struct Pipeline {
+		constexpr static DepthTest DEPTH_TEST = TEST;
+		constexpr static bool IS_DEPTH_WRITTEN = IS_WRITTEN;
+		constexpr static bool IS_DEPTH_USED = TEST != DEPTH_ALWAYS || IS_WRITTEN;
+		constexpr static Shading SHADING = SHADE;
+
+		// The pipeline drawing triangles without a texture
+		typedef Pipeline<TEST, IS_WRITTEN, SHADE == SHADE_TEXTURED ? SHADE_GOURAUD : SHADE> Untextured;
+
+		template<typename Value>
+		static bool isVisible(Value depth, Value bufferDepth) {
+			return TEST == DEPTH_ALWAYS || (TEST == DEPTH_EQUAL ? bufferDepth == depth : bufferDepth > depth);
+		}
+	};
+
+	/**
+	 * Divides a by a positive b, rounding towards positive infinity.
+	 */
+	long long ceilDivide(long long a, long long b) {
+		return a >= 0 ? (a + b - 1) / b : -(-a / b);
+	}
+
+	template<typename Depth>
+	void fillDepths(Uint8* depths, int offset, int length) {
+		typename Depth::Value* values = (typename Depth::Value*)depths + offset;
+
+		std::fill(values, values + length, Depth::CLEAR);
+	}
+
+	/**
+	 * A vertex attribute interpolated linearly across screen
+	 * space, evaluated at pixel centers.
+	 */
+	struct AttributePlane {
+		float stepX;
+		float stepY;
+		float constant;
+
+		float at(int x, int y) const {
+			return stepX * x + stepY * y + constant;
+		}
+	};
+
+	/**
+	 * Creates the plane interpolating attribute values a1, a2 and a3
+	 * across a triangle, given the offsets of its second and third
+	 * vertices from the first, and the reciprocal of its doubled area.
+	 */
+	AttributePlane createAttributePlane(const Vertex2d& v1, float a1, float a2, float a3, float x21, float y21, float x31, float y31, float inverseArea) {
+		constexpr float ONE = 1 << SUBPIXEL_BITS;
+
+		float stepX = ((a2 - a1) * y31 - (a3 - a1) * y21) * inverseArea;
+		float stepY = ((a3 - a1) * x21 - (a2 - a1) * x31) * inverseArea;
+
+		return {
+			stepX,
+			stepY,
+			a1 + stepX * (0.5f - v1.subpixel.x / ONE) + stepY * (0.5f - v1.subpixel.y / ONE)
+		};
+	}
+
+	// Colors and depths are stepped across pixels in fixed point with
+	// this many fractional bits
+	constexpr static int FIXED_POINT_BITS = 16;
+
+	long long toFixed(float value) {
+		return (long long)(value * (1 << FIXED_POINT_BITS));
+	}
+
+	/**
+	 * A color with each channel in fixed point, so that colors are
+	 * interpolated across pixels with integer adds alone. Channels are
+	 * offset by half, so that truncating them rounds to the nearest
+	 * value, and wrap rather than overflow, so that the extrapolated
+	 * colors of pixels outside of a triangle can't disturb those inside.
+	 */
+	struct FixedColor {
+		constexpr static Uint32 HALF = 1 << (FIXED_POINT_BITS - 1);
+
+		Uint32 R;
+		Uint32 G;
+		Uint32 B;
+
+		static FixedColor create(float R, float G, float B) {
+			return { (Uint32)toFixed(R) + HALF, (Uint32)toFixed(G) + HALF, (Uint32)toFixed(B) + HALF };
+		}
+
+		static FixedColor createStep(float R, float G, float B) {
+			return { (Uint32)toFixed(R), (Uint32)toFixed(G), (Uint32)toFixed(B) };
+		}
+
+		void step(const FixedColor& step) {
+			R += step.R;
+			G += step.G;
+			B += step.B;
+		}
+
+		/**
+		 * Steps over count pixels at once, landing on exactly the
+		 * value that stepping one pixel at a time would reach.
+		 */
+		void step(const FixedColor& step, int count) {
+			R += step.R * (Uint32)count;
+			G += step.G * (Uint32)count;
+			B += step.B * (Uint32)count;
+		}
+
+		/**
+		 * Packs the channels' integer parts into a pixel. With 16
+		 * fractional bits, red's integer part is already in place.
+		 */
+		Uint32 toPixel() const {
+			return 0xFF000000 | (R & 0xFF0000) | ((G >> 8) & 0xFF00) | ((B >> 16) & 0xFF);
+		}
+	};
+}
+
+/**
+ * The planes interpolating a textured triangle's texture coordinates
+ * divided by w, and 1 / w. Unlike the texture coordinates themselves,
+ * these are linear in screen space, so dividing one by the other at
+ * each pixel gives perspective-correct texture coordinates.
+ */
+struct Rasterizer::TextureMapping {
+	const Texture* texture = NULL;
+	AttributePlane u = { };
+	AttributePlane v = { };
+	AttributePlane inverseW = { };
+
+	TextureMapping() = default;
+
+	explicit TextureMapping(const Triangle& triangle) {
+		constexpr float ONE = 1 << SUBPIXEL_BITS;
+
+		const Vertex2d& v1 = triangle.vertices[0];
+		const Vertex2d& v2 = triangle.vertices[1];
+		const Vertex2d& v3 = triangle.vertices[2];
+		float x21 = (float)(v2.subpixel.x - v1.subpixel.x) / ONE;
+		float y21 = (float)(v2.subpixel.y - v1.subpixel.y) / ONE;
+		float x31 = (float)(v3.subpixel.x - v1.subpixel.x) / ONE;
+		float y31 = (float)(v3.subpixel.y - v1.subpixel.y) / ONE;
+		float inverseArea = 1.0f / (x21 * y31 - x31 * y21);
+
+		texture = triangle.texture;
+		u = createAttributePlane(v1, v1.uv.u * v1.inverseW, v2.uv.u * v2.inverseW, v3.uv.u * v3.inverseW, x21, y21, x31, y31, inverseArea);
+		v = createAttributePlane(v1, v1.uv.v * v1.inverseW, v2.uv.v * v2.inverseW, v3.uv.v * v3.inverseW, x21, y21, x31, y31, inverseArea);
+		inverseW = createAttributePlane(v1, v1.inverseW, v2.inverseW, v3.inverseW, x21, y21, x31, y31, inverseArea);
+	}
+
+	/**
+	 * Selects the mip level whose texels are nearest in size to the
+	 * pixel at (x, y), from how many texels its texture coordinates
+	 * move per pixel along whichever screen axis they move fastest.
+	 * Levels are selected once per block or span, rather than per
+	 * pixel, so that neighboring pixels fetch from the same level.
+	 */
+	const TextureLevel& selectLevel(int x, int y) const {
+		float w = 1.0f / inverseW.at(x, y);
+		float s = u.at(x, y) * w;
+		float t = v.at(x, y) * w;
+		float width = (float)texture->getWidth();
+		float height = (float)texture->getHeight();
+
+		// The derivatives of u / q are (u' - (u / q) * q') / q
+		float dsdx = (u.stepX - s * inverseW.stepX) * w * width;
+		float dtdx = (v.stepX - t * inverseW.stepX) * w * height;
+		float dsdy = (u.stepY - s * inverseW.stepY) * w * width;
+		float dtdy = (v.stepY - t * inverseW.stepY) * w * height;
+		float texelsPerPixelSquared = std::max(dsdx * dsdx + dtdx * dtdx, dsdy * dsdy + dtdy * dtdy);
+
+		// Rounds the log2 of the texels per pixel to the nearest level,
+		// as half the log2 of twice its square
+		int level = ilogbf(texelsPerPixelSquared * 2.0f) >> 1;
+
+		return texture->getLevel(std::min(std::max(level, 0), texture->getLevelCount() - 1));
+	}
+};
+
+Rasterizer::Rasterizer(RenderTarget* target, int width, int height) {
+	this->target = target;
 	this->width = width;
 	this->height = height;
 
-	screenTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, width, height);
-	pixelBuffer = new Uint32[width * height];
-	depthBuffer = new int[width * height];
+	tileColumns = (width + TILE_SIZE - 1) / TILE_SIZE;
+	tileRows = (height + TILE_SIZE - 1) / TILE_SIZE;
+	depthTileColumns = (width + DEPTH_TILE_SIZE - 1) / DEPTH_TILE_SIZE;
+	depthTileRows = (height + DEPTH_TILE_SIZE - 1) / DEPTH_TILE_SIZE;
+	depthTileMaxima.resize(depthTileColumns * depthTileRows);
+	depthTileWrites.resize(depthTileColumns * depthTileRows);
 
+	std::fill(depthTileMaxima.begin(), depthTileMaxima.end(), INT_MAX);
 	setColor(255, 255, 255);
-	clear();
+	addBufferSet();
+	beginFrame();
+	selectPipelines();
 }
 
 Rasterizer::~Rasterizer() {
-	SDL_DestroyTexture(screenTexture);
+	if (presentThread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(presentMutex);
+			isStopping = true;
+		}
+
+		presentCondition.notify_all();
+		presentThread.join();
+	}
 
-	delete[] pixelBuffer;
-	delete[] depthBuffer;
+	delete threadPool;
+
+	for (int i = 0; i < bufferSets.size(); i++) {
+		delete[] bufferSets.at(i).pixels;
+		delete[] bufferSets.at(i).depths;
+	}
 }
 
-void Rasterizer::clear() {
+/**
+ * Allocates a cleared pixel buffer and depth buffer.
+ */
+void Rasterizer::addBufferSet() {
+	BufferSet buffers;
 	int bufferLength = width * height;
+	int depthSize = depthFormat == DEPTH_16 ? sizeof(Depth16::Value) : sizeof(Depth32::Value);
+
+	buffers.pixels = new Uint32[bufferLength];
+	buffers.depths = new Uint8[bufferLength * depthSize];
+	buffers.tileEpochs.resize(depthTileColumns * depthTileRows, -1);
+	buffers.dirtyTiles.resize(depthTileColumns * depthTileRows, 0);
+
+	std::fill(buffers.pixels, buffers.pixels + bufferLength, 0);
+
+	if (depthFormat == DEPTH_16) {
+		fillDepths<Depth16>(buffers.depths, 0, bufferLength);
+	} else {
+		fillDepths<Depth32>(buffers.depths, 0, bufferLength);
+	}
+
+	bufferSets.push_back(buffers);
+}
+
+/**
+ * Adds a triangle to the bin of every tile its bounding box overlaps.
+ * Bins preserve submission order, so each pixel still sees the same
+ * sequence of depth tests as it would when rasterizing immediately.
+ */
+void Rasterizer::binTriangle(const Triangle& triangle) {
+	const Coordinate& c1 = triangle.vertices[0].coordinate;
+	const Coordinate& c2 = triangle.vertices[1].coordinate;
+	const Coordinate& c3 = triangle.vertices[2].coordinate;
+
+	int left = std::max(std::min({ c1.x, c2.x, c3.x }), 0);
+	int right = std::min(std::max({ c1.x, c2.x, c3.x }), width - 1);
+	int top = std::max(std::min({ c1.y, c2.y, c3.y }), 0);
+	int bottom = std::min(std::max({ c1.y, c2.y, c3.y }), height - 1);
+
+	if (left > right || top > bottom) {
+		return;
+	}
+
+	int triangleIndex = binnedTriangles.size();
 
-	std::fill(pixelBuffer, pixelBuffer + bufferLength, 0);
-	std::fill(depthBuffer, depthBuffer + bufferLength, INT_MAX);
+	binnedTriangles.push_back(triangle);
+
+	for (int row = top / TILE_SIZE; row <= bottom / TILE_SIZE; row++) {
+		for (int column = left / TILE_SIZE; column <= right / TILE_SIZE; column++) {
+			bins.at(row * tileColumns + column).push_back(triangleIndex);
+		}
+	}
 }
 
-void Rasterizer::flatTriangle(const Vertex2d& corner, const Vertex2d& left, const Vertex2d& right) {
+/**
+ * Selects the buffers the next frame is drawn into. Direct frames
+ * are drawn into memory locked from the target, falling back to the
+ * current buffer set whenever the target can't provide any.
+ */
+void Rasterizer::beginFrame() {
+	BufferSet& buffers = bufferSets.at(currentBufferSet);
+	Uint32* lockedPixels = NULL;
+	int pitch = width;
+
+	if (presentMode == PRESENT_DIRECT && !presentThread.joinable()) {
+		lockedPixels = target->lock(width, height, &pitch);
+	}
+
+	// Locked memory starts out undefined, and the buffer set's own
+	// pixels are stale after direct frames, so every tile has to be
+	// cleared or drawn into when either is involved
+	if (lockedPixels != NULL || isDirectFrame) {
+		std::fill(buffers.dirtyTiles.begin(), buffers.dirtyTiles.end(), 1);
+	}
+
+	isDirectFrame = lockedPixels != NULL;
+	pixelBuffer = isDirectFrame ? lockedPixels : buffers.pixels;
+	pixelPitch = isDirectFrame ? pitch : width;
+	depthBuffer = buffers.depths;
+}
+
+/**
+ * Clears the tiles of the current buffers which still hold pixels
+ * from an earlier frame, but weren't drawn into during this one.
+ */
+void Rasterizer::clearStaleTiles() {
+	PROFILE_SCOPE(PROFILE_CLEAR, "clear");
+
+	BufferSet& buffers = bufferSets.at(currentBufferSet);
+
+	for (int tile = 0; tile < buffers.dirtyTiles.size(); tile++) {
+		if (buffers.dirtyTiles[tile] && buffers.tileEpochs[tile] != frameEpoch) {
+			clearTile(tile);
+
+			buffers.dirtyTiles[tile] = 0;
+		}
+	}
+}
+
+/**
+ * Clears every tile of a buffer set which was drawn into, so that
+ * the next frame drawn into it needn't clear any. Runs on the present
+ * thread, once the buffer set's frame has been presented.
+ */
+void Rasterizer::clearBufferSet(BufferSet& buffers) {
+	PROFILE_SCOPE(PROFILE_CLEAR, "clear");
+
+	for (int tile = 0; tile < buffers.dirtyTiles.size(); tile++) {
+		if (buffers.dirtyTiles[tile]) {
+			clearTile(buffers.pixels, width, buffers.depths, tile);
+
+			buffers.dirtyTiles[tile] = 0;
+		}
+	}
+}
+
+void Rasterizer::clearTile(int tile) {
+	clearTile(pixelBuffer, pixelPitch, depthBuffer, tile);
+}
+
+void Rasterizer::clearTile(Uint32* pixels, int pitch, Uint8* depths, int tile) {
+	int left = (tile % depthTileColumns) * DEPTH_TILE_SIZE;
+	int top = (tile / depthTileColumns) * DEPTH_TILE_SIZE;
+	int tileWidth = std::min(left + DEPTH_TILE_SIZE, width) - left;
+	int bottom = std::min(top + DEPTH_TILE_SIZE, height);
+
+	for (int y = top; y < bottom; y++) {
+		Uint32* row = pixels + y * pitch + left;
+		int offset = y * width + left;
+
+		std::fill(row, row + tileWidth, 0);
+
+		if (depthFormat == DEPTH_16) {
+			fillDepths<Depth16>(depths, offset, tileWidth);
+		} else {
+			fillDepths<Depth32>(depths, offset, tileWidth);
+		}
+	}
+}
+
+/**
+ * Draws the part of a line within the clipping region with Bresenham's
+ * algorithm, optionally depth tested against the depth buffer. Step k
+ * along the line's major axis lands on the minor axis offset
+ * floor((2 * k * minor + major) / (2 * major)), so the range of steps
+ * within the clipping region is found up front, as with Liang-Barsky
+ * clipping, without any per-pixel bounds checks. Stepping starts from
+ * that offset rather than from a clipped endpoint, so lines split
+ * across tiles draw exactly the same pixels as they would unclipped.
+ */
+template<typename Depth, bool IS_DEPTH_TESTED>
+void Rasterizer::clippedLine(const Vertex2d& start, const Vertex2d& end, float depthBias, const Rect& clip) {
+	int x1 = start.coordinate.x;
+	int y1 = start.coordinate.y;
+	int stepX = end.coordinate.x >= x1 ? 1 : -1;
+	int stepY = end.coordinate.y >= y1 ? 1 : -1;
+	int deltaX = std::abs(end.coordinate.x - x1);
+	int deltaY = std::abs(end.coordinate.y - y1);
+	bool isXMajor = deltaX >= deltaY;
+	int major = isXMajor ? deltaX : deltaY;
+	int minor = isXMajor ? deltaY : deltaX;
+
+	// Offsets from the start along each axis which remain within
+	// the clipping region
+	int minOffsetX = stepX > 0 ? clip.left - x1 : x1 - (clip.right - 1);
+	int maxOffsetX = stepX > 0 ? clip.right - 1 - x1 : x1 - clip.left;
+	int minOffsetY = stepY > 0 ? clip.top - y1 : y1 - (clip.bottom - 1);
+	int maxOffsetY = stepY > 0 ? clip.bottom - 1 - y1 : y1 - clip.top;
+	int minMinorOffset = isXMajor ? minOffsetY : minOffsetX;
+	int maxMinorOffset = isXMajor ? maxOffsetY : maxOffsetX;
+	long long firstStep = std::max(0, isXMajor ? minOffsetX : minOffsetY);
+	long long lastStep = std::min(major, isXMajor ? maxOffsetX : maxOffsetY);
+	long long twoMajor = 2LL * std::max(major, 1);
+
+	if (minor == 0) {
+		if (minMinorOffset > 0 || maxMinorOffset < 0) {
+			return;
+		}
+	} else {
+		firstStep = std::max(firstStep, ceilDivide(twoMajor * minMinorOffset - major, 2LL * minor));
+		lastStep = std::min(lastStep, ceilDivide(twoMajor * (maxMinorOffset + 1) - major, 2LL * minor) - 1);
+	}
+
+	if (firstStep > lastStep) {
+		return;
+	}
+
+	long long numerator = 2 * firstStep * minor + major;
+	int minorOffset = (int)(numerator / twoMajor);
+	long long error = numerator % twoMajor;
+	int x = x1 + stepX * (int)(isXMajor ? firstStep : minorOffset);
+	int y = y1 + stepY * (int)(isXMajor ? minorOffset : firstStep);
+	int majorStepX = isXMajor ? stepX : 0;
+	int majorStepY = isXMajor ? 0 : stepY;
+	// Depths step in fixed point from the start of the line, so that
+	// they're also the same however the line is clipped
+	long long depthStep = major > 0 ? toFixed((float)(end.depth - start.depth) / major) : 0;
+	long long depth = ((long long)start.depth << FIXED_POINT_BITS) - toFixed(depthBias) + depthStep * firstStep;
+	const typename Depth::Value* depths = (const typename Depth::Value*)depthBuffer;
+	int lastTile = -1;
+
+	for (long long step = firstStep; step <= lastStep; step++) {
+		int tile = (y / DEPTH_TILE_SIZE) * depthTileColumns + x / DEPTH_TILE_SIZE;
+
+		if (tile != lastTile) {
+			prepareTile(tile);
+
+			lastTile = tile;
+		}
+
+		if (!IS_DEPTH_TESTED || Depth::encode((int)(depth >> FIXED_POINT_BITS)) <= depths[y * width + x]) {
+			pixelBuffer[y * pixelPitch + x] = color;
+		}
+
+		x += majorStepX;
+		y += majorStepY;
+		depth += depthStep;
+		error += 2 * minor;
+
+		if (error >= twoMajor) {
+			error -= twoMajor;
+			x += isXMajor ? 0 : stepX;
+			y += isXMajor ? stepY : 0;
+		}
+	}
+}
+
+/**
+ * Enables binned rasterization. Filled triangles are collected into
+ * per-tile bins as they are submitted, and the tiles are rasterized
+ * in parallel across the given number of threads once the frame is
+ * rendered. Since each tile is owned by exactly one thread at a time,
+ * no synchronization is needed on the pixel path.
+ */
+void Rasterizer::enableBinning(int threadCount) {
+	delete threadPool;
+
+	threadPool = new ThreadPool(std::max(threadCount, 1));
+
+	bins.resize(tileColumns * tileRows);
+}
+
+/**
+ * Returns the number of triangles rejected by the coarse depth test
+ * during the most recently rendered frame. When binning, each
+ * tile a triangle is rejected from counts separately.
+ */
+int Rasterizer::getOccludedTriangleCount() {
+	return lastOccludedTriangleCount;
+}
+
+/**
+ * Returns the present mode in effect for the current frame, which is
+ * the copy path whenever direct presentation isn't available.
+ */
+PresentMode Rasterizer::getPresentMode() {
+	return isDirectFrame ? PRESENT_DIRECT : PRESENT_COPY;
+}
+
+/**
+ * Moves presentation to a dedicated thread, cycling through the given
+ * number of pixel and depth buffers. Once a frame is rendered, it's
+ * handed off to be presented on that thread, while the next frame is
+ * drawn into the next buffer. Targets bound to their creating thread
+ * are still presented to from render(), and only the clearing of
+ * presented buffers is handed off. Drawing only waits when every other
+ * buffer is still queued. This must be enabled before the first frame
+ * is drawn.
+ */
+void Rasterizer::enablePresentThread(int bufferCount) {
+	if (presentThread.joinable()) {
+		return;
+	}
+
+	while (bufferSets.size() < std::max(bufferCount, 2)) {
+		addBufferSet();
+	}
+
+	presentThread = std::thread(&Rasterizer::presentFrames, this);
+}
+
+/**
+ * Blocks until every rendered frame has been presented.
+ */
+void Rasterizer::finish() {
+	std::unique_lock<std::mutex> lock(presentMutex);
+
+	presentCondition.wait(lock, [=]() {
+		return presentedFrames == submittedFrames;
+	});
+}
+
+/**
+ * Rasterizes a triangle with a horizontal edge opposite the given
+ * corner, row by row. Vertex colors are only interpolated along the
+ * edges when Gouraud shading, while flat triangles use flatColor, and
+ * textured triangles are mapped by the whole triangle's mapping.
+ */
+template<typename Depth, typename Pipeline>
+void Rasterizer::flatTriangle(const Vertex2d& corner, const Vertex2d& left, const Vertex2d& right, const Color& flatColor, const TextureMapping* mapping, const Rect& clip) {
 	int isHorizontallyOffscreen = (
-		(corner.coordinate.x >= width && left.coordinate.x >= width) ||
-		(corner.coordinate.x < 0 && right.coordinate.x < 0)
+		(corner.coordinate.x >= clip.right && left.coordinate.x >= clip.right) ||
+		(corner.coordinate.x < clip.left && right.coordinate.x < clip.left)
 	);
 
 	if (isHorizontallyOffscreen) {
@@ -44,101 +580,696 @@ void Rasterizer::flatTriangle(const Vertex2d& corner, const Vertex2d& left, cons
 
 	int triangleHeight = std::abs(left.coordinate.y - corner.coordinate.y);
 	int topY = std::min(corner.coordinate.y, left.coordinate.y);
-	float leftSlope = (float)triangleHeight / (left.coordinate.x - corner.coordinate.x);
-	float rightSlope = (float)triangleHeight / (right.coordinate.x - corner.coordinate.x);
+	// Edges are stepped by their inverse slopes, which remain finite
+	// for vertical edges. Rows are only drawn for nonzero heights.
+	float leftInverseSlope = triangleHeight > 0 ? (float)(left.coordinate.x - corner.coordinate.x) / triangleHeight : 0;
+	float rightInverseSlope = triangleHeight > 0 ? (float)(right.coordinate.x - corner.coordinate.x) / triangleHeight : 0;
 	bool hasFlatTop = corner.coordinate.y > left.coordinate.y;
-	int i = topY < 0 ? -topY : 0;
+	int i = topY < clip.top ? clip.top - topY : 0;
 
 	while (i < triangleHeight) {
 		int y = topY + i;
 
-		if (y >= height) {
+		if (y >= clip.bottom) {
 			break;
 		}
 
 		int j = hasFlatTop ? triangleHeight - i : i;
 		float progress = (float)j / triangleHeight;
-		int startX = corner.coordinate.x + (int)j / leftSlope;
-		int endX = corner.coordinate.x + (int)j / rightSlope;
-		Color leftColor = lerp(corner.color, left.color, progress);
-		Color rightColor = lerp(corner.color, right.color, progress);
-		int leftDepth = lerp(corner.depth, left.depth, progress);
-		int rightDepth = lerp(corner.depth, right.depth, progress);
+		int startX = corner.coordinate.x + j * leftInverseSlope;
+		int endX = corner.coordinate.x + j * rightInverseSlope;
+		bool isGouraud = Pipeline::SHADING == SHADE_GOURAUD;
+		Color leftColor = isGouraud ? lerp(corner.color, left.color, progress) : flatColor;
+		Color rightColor = isGouraud ? lerp(corner.color, right.color, progress) : flatColor;
+		int leftDepth = Pipeline::IS_DEPTH_USED ? lerp(corner.depth, left.depth, progress) : 0;
+		int rightDepth = Pipeline::IS_DEPTH_USED ? lerp(corner.depth, right.depth, progress) : 0;
 
-		triangleScanLine(startX, y, endX - startX, leftColor, rightColor, leftDepth, rightDepth);
+		triangleScanLine<Depth, Pipeline>(startX, y, endX - startX, leftColor, rightColor, leftDepth, rightDepth, mapping, clip);
 
 		i++;
 	}
 }
 
-void Rasterizer::flatBottomTriangle(const Vertex2d& top, const Vertex2d& bottomLeft, const Vertex2d& bottomRight) {
-	flatTriangle(top, bottomLeft, bottomRight);
+/**
+ * Rasterizes every binned triangle, one tile per task, then empties
+ * the bins for the next frame. With a depth prepass, each tile's depth
+ * pass and color pass run back to back, while its depths are still
+ * in cache.
+ */
+void Rasterizer::flushBins() {
+	if (binnedTriangles.empty()) {
+		return;
+	}
+
+	threadPool->run(bins.size(), [=](int tile) {
+		PROFILE_SCOPE(PROFILE_FILL, "tile");
+
+		Rect clip = getTileRect(tile);
+		const std::vector<int>& bin = bins.at(tile);
+
+		if (depthPassFunction != NULL) {
+			for (int i = 0; i < bin.size(); i++) {
+				(this->*depthPassFunction)(binnedTriangles.at(bin.at(i)), clip);
+			}
+		}
+
+		for (int i = 0; i < bin.size(); i++) {
+			if (!(this->*rasterizeFunction)(binnedTriangles.at(bin.at(i)), clip)) {
+				occludedTriangleCount.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+	});
+
+	for (int i = 0; i < bins.size(); i++) {
+		bins.at(i).clear();
+	}
+
+	binnedTriangles.clear();
 }
 
-void Rasterizer::flatTopTriangle(const Vertex2d& topLeft, const Vertex2d& topRight, const Vertex2d& bottom) {
-	flatTriangle(bottom, topLeft, topRight);
+/**
+ * Runs the color pass over the triangles deferred by a depth prepass
+ * without binning, once every triangle's depth has been written.
+ */
+void Rasterizer::flushColorPass() {
+	PROFILE_SCOPE(PROFILE_FILL, "color pass");
+
+	Rect clip = { 0, 0, width, height };
+
+	for (int i = 0; i < binnedTriangles.size(); i++) {
+		if (!(this->*rasterizeFunction)(binnedTriangles.at(i), clip)) {
+			occludedTriangleCount.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	binnedTriangles.clear();
 }
 
-void Rasterizer::line(int x1, int y1, int x2, int y2) {
-	bool isOffScreen = (
-		std::max(x1, x2) < 0 ||
-		std::min(x1, x2) >= width ||
-		std::max(y1, y2) < 0 ||
-		std::min(y1, y2) >= height
+Rect Rasterizer::getTileRect(int tile) {
+	Rect rect;
+
+	rect.left = (tile % tileColumns) * TILE_SIZE;
+	rect.top = (tile / tileColumns) * TILE_SIZE;
+	rect.right = std::min(rect.left + TILE_SIZE, width);
+	rect.bottom = std::min(rect.top + TILE_SIZE, height);
+
+	return rect;
+}
+
+namespace {
+	/**
+	 * A triangle edge function, evaluated at pixel centers. Values
+	 * are non-negative for pixels on the inner side of the edge.
+	 */
+	struct EdgeFunction {
+		long long stepX;
+		long long stepY;
+		long long constant;
+
+		long long at(int x, int y) const {
+			return stepX * x + stepY * y + constant;
+		}
+	};
+
+	/**
+	 * Creates the edge function for the edge running from (x1, y1)
+	 * to (x2, y2) in sub-pixel coordinates. Pixels lying exactly on
+	 * the edge only count as inside of top and left edges.
+	 */
+	EdgeFunction createEdgeFunction(long long x1, long long y1, long long x2, long long y2) {
+		constexpr long long ONE = 1 << SUBPIXEL_BITS;
+		constexpr long long HALF = ONE / 2;
+
+		long long a = y1 - y2;
+		long long b = x2 - x1;
+		bool isTopLeft = a > 0 || (a == 0 && b > 0);
+
+		return {
+			a * ONE,
+			b * ONE,
+			a * (HALF - x1) + b * (HALF - y1) + (isTopLeft ? 0 : -1)
+		};
+	}
+}
+
+/**
+ * Rasterizes a filled triangle by evaluating its edge functions over
+ * BLOCK_SIZE x BLOCK_SIZE pixel blocks, using the vertices' sub-pixel
+ * coordinates. Blocks entirely outside of an edge are skipped, and
+ * blocks entirely inside of all three edges are filled without any
+ * per-pixel coverage tests. Pixels are sampled at their centers, and
+ * the top-left fill rule guarantees that triangles sharing an edge
+ * neither leave gaps nor draw the same pixel twice.
+ */
+template<typename Depth, typename Pipeline>
+void Rasterizer::halfSpaceTriangle(const Triangle& triangle, const Rect& clip) {
+	const Vertex2d* v1 = &triangle.vertices[0];
+	const Vertex2d* v2 = &triangle.vertices[1];
+	const Vertex2d* v3 = &triangle.vertices[2];
+
+	long long area = (
+		(long long)(v2->subpixel.x - v1->subpixel.x) * (v3->subpixel.y - v1->subpixel.y) -
+		(long long)(v3->subpixel.x - v1->subpixel.x) * (v2->subpixel.y - v1->subpixel.y)
 	);
 
-	if (isOffScreen) {
+	if (area == 0) {
 		return;
+	} else if (area < 0) {
+		// Edge functions expect a consistent winding order
+		std::swap(v2, v3);
 	}
 
-	int deltaX = x2 - x1;
-	int deltaY = y2 - y1;
-	bool isGoingLeft = deltaX < 0;
-	bool isGoingUp = deltaY < 0;
-	int totalPixels = abs(deltaX) + abs(deltaY);
+	// Pixel x is sampled at sub-pixel x * ONE + HALF, so the bounds
+	// are the first and last pixel centers within the vertex extents
+	constexpr int ONE = 1 << SUBPIXEL_BITS;
+	constexpr int HALF = ONE / 2;
 
-	for (int i = 0; i < totalPixels; i++) {
-		float progress = (float)i / totalPixels;
-		int x = x1 + (int)(deltaX * progress);
-		int y = y1 + (int)(deltaY * progress);
+	int left = std::max((std::min({ v1->subpixel.x, v2->subpixel.x, v3->subpixel.x }) - HALF + ONE - 1) >> SUBPIXEL_BITS, clip.left);
+	int right = std::min((std::max({ v1->subpixel.x, v2->subpixel.x, v3->subpixel.x }) - HALF) >> SUBPIXEL_BITS, clip.right - 1);
+	int top = std::max((std::min({ v1->subpixel.y, v2->subpixel.y, v3->subpixel.y }) - HALF + ONE - 1) >> SUBPIXEL_BITS, clip.top);
+	int bottom = std::min((std::max({ v1->subpixel.y, v2->subpixel.y, v3->subpixel.y }) - HALF) >> SUBPIXEL_BITS, clip.bottom - 1);
 
-		bool isGoingOffScreen = (
-			(isGoingLeft && x < 0) ||
-			(!isGoingLeft && x >= width) ||
-			(isGoingUp && y < 0) ||
-			(!isGoingUp && y >= height)
-		);
+	if (left > right || top > bottom) {
+		return;
+	}
 
-		if (isGoingOffScreen) {
-			break;
-		} else if (x < 0 || x >= width || y < 0 || y >= height) {
-			continue;
+	EdgeFunction edges[3] = {
+		createEdgeFunction(v2->subpixel.x, v2->subpixel.y, v3->subpixel.x, v3->subpixel.y),
+		createEdgeFunction(v3->subpixel.x, v3->subpixel.y, v1->subpixel.x, v1->subpixel.y),
+		createEdgeFunction(v1->subpixel.x, v1->subpixel.y, v2->subpixel.x, v2->subpixel.y)
+	};
+
+	float x21 = (float)(v2->subpixel.x - v1->subpixel.x) / ONE;
+	float y21 = (float)(v2->subpixel.y - v1->subpixel.y) / ONE;
+	float x31 = (float)(v3->subpixel.x - v1->subpixel.x) / ONE;
+	float y31 = (float)(v3->subpixel.y - v1->subpixel.y) / ONE;
+	float inverseArea = 1.0f / (x21 * y31 - x31 * y21);
+
+	AttributePlane depthPlane = { };
+	AttributePlane redPlane = { };
+	AttributePlane greenPlane = { };
+	AttributePlane bluePlane = { };
+	Uint32 flatPixel = triangle.vertices[0].color.value;
+
+	if (Pipeline::IS_DEPTH_USED) {
+		depthPlane = createAttributePlane(*v1, v1->depth, v2->depth, v3->depth, x21, y21, x31, y31, inverseArea);
+	}
+
+	if (Pipeline::SHADING == SHADE_GOURAUD) {
+		redPlane = createAttributePlane(*v1, v1->color.getR(), v2->color.getR(), v3->color.getR(), x21, y21, x31, y31, inverseArea);
+		greenPlane = createAttributePlane(*v1, v1->color.getG(), v2->color.getG(), v3->color.getG(), x21, y21, x31, y31, inverseArea);
+		bluePlane = createAttributePlane(*v1, v1->color.getB(), v2->color.getB(), v3->color.getB(), x21, y21, x31, y31, inverseArea);
+	}
+
+	// Each row of a block starts from the planes, and steps across
+	// the block in fixed point
+	long long depthStep = toFixed(depthPlane.stepX);
+	FixedColor colorStep = FixedColor::createStep(redPlane.stepX, greenPlane.stepX, bluePlane.stepX);
+
+	TextureMapping mapping;
+
+	if (Pipeline::SHADING == SHADE_TEXTURED) {
+		mapping = TextureMapping(triangle);
+	}
+
+	int testedPixels = 0;
+	int writtenPixels = 0;
+
+	for (int blockY = top - top % BLOCK_SIZE; blockY <= bottom; blockY += BLOCK_SIZE) {
+		int y1 = std::max(blockY, top);
+		int y2 = std::min(blockY + BLOCK_SIZE - 1, bottom);
+
+		for (int blockX = left - left % BLOCK_SIZE; blockX <= right; blockX += BLOCK_SIZE) {
+			int x1 = std::max(blockX, left);
+			int x2 = std::min(blockX + BLOCK_SIZE - 1, right);
+			bool isCovered = true;
+			bool isRejected = false;
+
+			// Edge functions are linear, so testing the block's corner
+			// pixels determines whether the block is entirely inside
+			// or entirely outside of each edge
+			for (int e = 0; e < 3 && !isRejected; e++) {
+				int insideCorners = (
+					(edges[e].at(x1, y1) >= 0) +
+					(edges[e].at(x2, y1) >= 0) +
+					(edges[e].at(x1, y2) >= 0) +
+					(edges[e].at(x2, y2) >= 0)
+				);
+
+				isRejected = insideCorners == 0;
+				isCovered = isCovered && insideCorners == 4;
+			}
+
+			if (isRejected) {
+				continue;
+			}
+
+			const TextureLevel* level = Pipeline::SHADING == SHADE_TEXTURED ? &mapping.selectLevel((x1 + x2) / 2, (y1 + y2) / 2) : NULL;
+
+			for (int y = y1; y <= y2; y++) {
+				long long w1 = edges[0].at(x1, y);
+				long long w2 = edges[1].at(x1, y);
+				long long w3 = edges[2].at(x1, y);
+				long long depth = toFixed(depthPlane.at(x1, y));
+				FixedColor shadedColor = FixedColor::create(redPlane.at(x1, y), greenPlane.at(x1, y), bluePlane.at(x1, y));
+				float uOverW = mapping.u.at(x1, y);
+				float vOverW = mapping.v.at(x1, y);
+				float inverseW = mapping.inverseW.at(x1, y);
+				Uint32* pixel = pixelBuffer + y * pixelPitch + x1;
+				typename Depth::Value* pixelDepth = (typename Depth::Value*)depthBuffer + y * width + x1;
+
+				for (int x = x1; x <= x2; x++) {
+					typename Depth::Value encodedDepth = Pipeline::IS_DEPTH_USED ? Depth::encode((int)(depth >> FIXED_POINT_BITS)) : 0;
+					bool isInside = isCovered || (w1 | w2 | w3) >= 0;
+
+					testedPixels += isInside;
+
+					if (isInside && (Pipeline::DEPTH_TEST == DEPTH_ALWAYS || Pipeline::isVisible(encodedDepth, *pixelDepth))) {
+						if (Pipeline::SHADING == SHADE_GOURAUD) {
+							*pixel = shadedColor.toPixel();
+						} else if (Pipeline::SHADING == SHADE_FLAT) {
+							*pixel = flatPixel;
+						} else if (Pipeline::SHADING == SHADE_TEXTURED) {
+							float w = 1.0f / inverseW;
+
+							*pixel = level->sample(uOverW * w, vOverW * w);
+						}
+
+						if (Pipeline::IS_DEPTH_WRITTEN) {
+							*pixelDepth = encodedDepth;
+						}
+
+						writtenPixels += Pipeline::SHADING != SHADE_NONE;
+					}
+
+					w1 += edges[0].stepX;
+					w2 += edges[1].stepX;
+					w3 += edges[2].stepX;
+					depth += depthStep;
+					shadedColor.step(colorStep);
+					uOverW += mapping.u.stepX;
+					vOverW += mapping.v.stepX;
+					inverseW += mapping.inverseW.stepX;
+					pixel++;
+					pixelDepth++;
+				}
+			}
 		}
+	}
+
+	PROFILE_COUNT(PROFILE_PIXELS_TESTED, testedPixels);
+	PROFILE_COUNT(PROFILE_PIXELS_WRITTEN, writtenPixels);
+}
+
+/**
+ * Counts a write to the depth tiles overlapping the given bounds, after
+ * pixels within them may have been written. Depth tested writes only
+ * bring depths nearer, so a stale maximum is still an upper bound, and
+ * is only rescanned once it's too far to reject something and enough
+ * writes have built up to make a rescan worthwhile. Untested writes
+ * can push depths further, so their tiles' maxima are rescanned the
+ * next time they're needed.
+ */
+void Rasterizer::invalidateDepthTiles(const Rect& bounds, bool isDepthTested) {
+	for (int row = bounds.top / DEPTH_TILE_SIZE; row <= (bounds.bottom - 1) / DEPTH_TILE_SIZE; row++) {
+		for (int column = bounds.left / DEPTH_TILE_SIZE; column <= (bounds.right - 1) / DEPTH_TILE_SIZE; column++) {
+			int tile = row * depthTileColumns + column;
+
+			if (isDepthTested) {
+				depthTileWrites[tile] += depthTileWrites[tile] < DEPTH_TILE_RESCAN_WRITES;
+			} else {
+				depthTileMaxima[tile] = INT_MAX;
+				depthTileWrites[tile] = DEPTH_TILE_RESCAN_WRITES;
+			}
+		}
+	}
+}
+
+/**
+ * Determines whether anything within the given screen bounds, at no
+ * nearer than minDepth, would be hidden behind what has already been
+ * drawn. This compares minDepth against the maximum depth of each
+ * DEPTH_TILE_SIZE x DEPTH_TILE_SIZE tile the bounds overlap, allowing
+ * whole triangles or objects to be rejected without depth testing
+ * their pixels individually.
+ */
+bool Rasterizer::isOccluded(const Rect& bounds, int minDepth) {
+	if (bounds.left >= bounds.right || bounds.top >= bounds.bottom) {
+		return true;
+	}
 
-		setPixel(x, y);
+	for (int row = bounds.top / DEPTH_TILE_SIZE; row <= (bounds.bottom - 1) / DEPTH_TILE_SIZE; row++) {
+		for (int column = bounds.left / DEPTH_TILE_SIZE; column <= (bounds.right - 1) / DEPTH_TILE_SIZE; column++) {
+			int tile = row * depthTileColumns + column;
+
+			// Interpolated depths may round to one less than the
+			// nearest vertex depth, so tiles only occlude depths
+			// strictly beyond their maximum. Dense meshes write to
+			// each tile many times, so stale maxima are only rescanned
+			// every DEPTH_TILE_RESCAN_WRITES writes, when they can't
+			// occlude minDepth as they are.
+			if (depthTileMaxima[tile] >= minDepth) {
+				if (depthTileWrites[tile] < DEPTH_TILE_RESCAN_WRITES) {
+					return false;
+				}
+
+				updateDepthTile(tile);
+
+				if (depthTileMaxima[tile] >= minDepth) {
+					return false;
+				}
+			}
+		}
 	}
+
+	return true;
 }
 
-void Rasterizer::render(SDL_Renderer* renderer) {
-	SDL_UpdateTexture(screenTexture, NULL, pixelBuffer, width * sizeof(Uint32));
-	SDL_RenderCopy(renderer, screenTexture, NULL, NULL);
-	SDL_RenderPresent(renderer);
-	clear();
+/**
+ * Draws a line in the current color over whatever has been drawn,
+ * without depth testing.
+ */
+void Rasterizer::line(int x1, int y1, int x2, int y2) {
+	Vertex2d start;
+	Vertex2d end;
+
+	start.coordinate = { x1, y1 };
+	end.coordinate = { x2, y2 };
+
+	clippedLine<Depth32, false>(start, end, 0, { 0, 0, width, height });
+}
+
+void Rasterizer::render() {
+	if (threadPool != NULL) {
+		flushBins();
+	} else if (isDepthPrepassEnabled) {
+		flushColorPass();
+	}
+
+	lastOccludedTriangleCount = occludedTriangleCount;
+	occludedTriangleCount = 0;
+
+	clearStaleTiles();
+
+	frameEpoch++;
+
+	std::fill(depthTileMaxima.begin(), depthTileMaxima.end(), INT_MAX);
+	std::fill(depthTileWrites.begin(), depthTileWrites.end(), 0);
+
+	if (!presentThread.joinable()) {
+		PROFILE_SCOPE(PROFILE_PRESENT, "present");
+
+		target->present(pixelBuffer, width, height);
+		beginFrame();
+
+		return;
+	}
+
+	if (target->isThreadBound()) {
+		PROFILE_SCOPE(PROFILE_PRESENT, "present");
+
+		target->present(pixelBuffer, width, height);
+	}
+
+	int bufferCount = bufferSets.size();
+
+	{
+		std::unique_lock<std::mutex> lock(presentMutex);
+
+		submittedFrames++;
+		presentCondition.notify_all();
+
+		// The next buffer is free once the frame last drawn into it
+		// has been presented
+		presentCondition.wait(lock, [=]() {
+			return presentedFrames > submittedFrames - bufferCount;
+		});
+
+		currentBufferSet = submittedFrames % bufferCount;
+	}
+
+	beginFrame();
+}
+
+/**
+ * Presents submitted frames in order, unless the target is bound to
+ * the drawing thread, then clears their buffers for reuse, until the
+ * rasterizer is destroyed. Runs on the present thread.
+ */
+void Rasterizer::presentFrames() {
+	std::unique_lock<std::mutex> lock(presentMutex);
+
+	while (true) {
+		presentCondition.wait(lock, [=]() {
+			return isStopping || presentedFrames < submittedFrames;
+		});
+
+		if (presentedFrames == submittedFrames) {
+			return;
+		}
+
+		int buffer = presentedFrames % bufferSets.size();
+
+		lock.unlock();
+
+		if (!target->isThreadBound()) {
+			PROFILE_SCOPE(PROFILE_PRESENT, "present");
+
+			target->present(bufferSets.at(buffer).pixels, width, height);
+		}
+
+		clearBufferSet(bufferSets.at(buffer));
+
+		lock.lock();
+
+		presentedFrames++;
+		presentCondition.notify_all();
+	}
+}
+
+/**
+ * Clears a tile if it hasn't yet been drawn into during this frame,
+ * before pixels within it are written. Tiles only ever belong to a
+ * single bin, so bins can be prepared in parallel.
+ */
+void Rasterizer::prepareTile(int tile) {
+	BufferSet& buffers = bufferSets.at(currentBufferSet);
+
+	if (buffers.tileEpochs[tile] != frameEpoch) {
+		if (buffers.dirtyTiles[tile]) {
+			PROFILE_STAGE(PROFILE_CLEAR);
+
+			clearTile(tile);
+		}
+
+		buffers.tileEpochs[tile] = frameEpoch;
+		buffers.dirtyTiles[tile] = 1;
+	}
+}
+
+void Rasterizer::prepareTiles(const Rect& bounds) {
+	for (int row = bounds.top / DEPTH_TILE_SIZE; row <= (bounds.bottom - 1) / DEPTH_TILE_SIZE; row++) {
+		for (int column = bounds.left / DEPTH_TILE_SIZE; column <= (bounds.right - 1) / DEPTH_TILE_SIZE; column++) {
+			prepareTile(row * depthTileColumns + column);
+		}
+	}
 }
 
 void Rasterizer::setColor(int R, int G, int B) {
-	color = (255 << 24) | (R << 16) | (G << 8) | B;
+	color = toPixel(R, G, B);
 }
 
 void Rasterizer::setColor(Color* color) {
-	setColor(color->R, color->G, color->B);
+	this->color = color->value;
 }
 
-void Rasterizer::setPixel(int x, int y, int depth) {
-	int index = y * width + x;
+/**
+ * Sets the storage format of the depth buffers. This reallocates
+ * them, so it must be done before the first frame is drawn.
+ */
+void Rasterizer::setDepthFormat(DepthFormat depthFormat) {
+	int bufferLength = width * height;
+
+	this->depthFormat = depthFormat;
+
+	for (int i = 0; i < bufferSets.size(); i++) {
+		BufferSet& buffers = bufferSets.at(i);
+
+		delete[] buffers.depths;
+
+		if (depthFormat == DEPTH_16) {
+			buffers.depths = new Uint8[bufferLength * sizeof(Depth16::Value)];
+
+			fillDepths<Depth16>(buffers.depths, 0, bufferLength);
+		} else {
+			buffers.depths = new Uint8[bufferLength * sizeof(Depth32::Value)];
+
+			fillDepths<Depth32>(buffers.depths, 0, bufferLength);
+		}
+	}
+
+	depthBuffer = bufferSets.at(currentBufferSet).depths;
+
+	selectPipelines();
+}
+
+/**
+ * Sets whether filled triangles are drawn with a depth prepass. Their
+ * depths are all written before any of them are shaded, at the cost
+ * of rasterizing each triangle twice, so that pixels covered by many
+ * triangles are only shaded once. Without binning, depths are written
+ * as triangles are drawn, keeping occlusion tests up to date, and
+ * triangles are shaded when the frame is rendered. This must only be
+ * changed between frames.
+ */
+void Rasterizer::setDepthPrepass(bool isEnabled) {
+	isDepthPrepassEnabled = isEnabled;
+
+	selectPipelines();
+}
+
+/**
+ * Sets how frames are handed to the render target, starting with the
+ * next frame. Direct presentation falls back to copying frames when
+ * the target doesn't support it, or frames are presented on a present
+ * thread, since target memory can only be locked on the thread which
+ * presents it.
+ */
+void Rasterizer::setPresentMode(PresentMode presentMode) {
+	this->presentMode = presentMode;
 
-	pixelBuffer[index] = color;
-	depthBuffer[index] = depth;
+	beginFrame();
+}
+
+/**
+ * Sets the state triangles are drawn with, and selects the rasterizer
+ * specialized for it. Binned and deferred triangles are all drawn with
+ * the state in effect when the frame is rendered, so this must only be
+ * changed between frames.
+ */
+void Rasterizer::setState(const RasterState& state) {
+	this->state = state;
+
+	selectPipelines();
+}
+
+void Rasterizer::setTraversal(TriangleTraversal traversal) {
+	this->traversal = traversal;
+
+	selectPipelines();
+}
+
+/**
+ * Selects the rasterizers for the current state, depth format and
+ * traversal. A depth prepass turns depth tested, shaded triangles into
+ * a depth pass, followed by a color pass shading the pixels whose
+ * depths are equal to the nearest written.
+ */
+void Rasterizer::selectPipelines() {
+	bool isPrepassed = (
+		isDepthPrepassEnabled &&
+		!state.isWireframe &&
+		state.depthTest == DEPTH_LESS &&
+		state.isDepthWritten &&
+		state.shading != SHADE_NONE
+	);
+
+	if (isPrepassed) {
+		RasterState depthState = state;
+		RasterState colorState = state;
+
+		depthState.shading = SHADE_NONE;
+		colorState.depthTest = DEPTH_EQUAL;
+		colorState.isDepthWritten = false;
+
+		depthPassFunction = selectRasterizer(depthState);
+		rasterizeFunction = selectRasterizer(colorState);
+	} else {
+		depthPassFunction = NULL;
+		rasterizeFunction = selectRasterizer(state);
+	}
+}
+
+Rasterizer::RasterizeFunction Rasterizer::selectRasterizer(const RasterState& state) {
+	return depthFormat == DEPTH_16 ? selectTraversal<Depth16>(state) : selectTraversal<Depth32>(state);
+}
+
+template<typename Depth>
+Rasterizer::RasterizeFunction Rasterizer::selectTraversal(const RasterState& state) {
+	return traversal == HALF_SPACE_TRAVERSAL ? selectDepthTest<Depth, HALF_SPACE_TRAVERSAL>(state) : selectDepthTest<Depth, SCANLINE_TRAVERSAL>(state);
+}
+
+template<typename Depth, TriangleTraversal TRAVERSAL>
+Rasterizer::RasterizeFunction Rasterizer::selectDepthTest(const RasterState& state) {
+	if (state.isWireframe) {
+		return (
+			state.depthTest == DEPTH_ALWAYS
+				? &Rasterizer::rasterizeWireframe<Depth, TRAVERSAL, false>
+				: &Rasterizer::rasterizeWireframe<Depth, TRAVERSAL, true>
+		);
+	}
+
+	switch (state.depthTest) {
+		case DEPTH_ALWAYS:
+			return (
+				state.isDepthWritten
+					? selectShading<Depth, TRAVERSAL, DEPTH_ALWAYS, true>(state.shading)
+					: selectShading<Depth, TRAVERSAL, DEPTH_ALWAYS, false>(state.shading)
+			);
+		case DEPTH_EQUAL:
+			return (
+				state.isDepthWritten
+					? selectShading<Depth, TRAVERSAL, DEPTH_EQUAL, true>(state.shading)
+					: selectShading<Depth, TRAVERSAL, DEPTH_EQUAL, false>(state.shading)
+			);
+		default:
+			return (
+				state.isDepthWritten
+					? selectShading<Depth, TRAVERSAL, DEPTH_LESS, true>(state.shading)
+					: selectShading<Depth, TRAVERSAL, DEPTH_LESS, false>(state.shading)
+			);
+	}
+}
+
+template<typename Depth, TriangleTraversal TRAVERSAL, DepthTest DEPTH_TEST, bool IS_DEPTH_WRITTEN>
+Rasterizer::RasterizeFunction Rasterizer::selectShading(Shading shading) {
+	switch (shading) {
+		case SHADE_NONE:
+			return &Rasterizer::rasterizeTriangle<Depth, TRAVERSAL, Pipeline<DEPTH_TEST, IS_DEPTH_WRITTEN, SHADE_NONE>>;
+		case SHADE_FLAT:
+			return &Rasterizer::rasterizeTriangle<Depth, TRAVERSAL, Pipeline<DEPTH_TEST, IS_DEPTH_WRITTEN, SHADE_FLAT>>;
+		case SHADE_TEXTURED:
+			return &Rasterizer::rasterizeTriangle<Depth, TRAVERSAL, Pipeline<DEPTH_TEST, IS_DEPTH_WRITTEN, SHADE_TEXTURED>>;
+		default:
+			return &Rasterizer::rasterizeTriangle<Depth, TRAVERSAL, Pipeline<DEPTH_TEST, IS_DEPTH_WRITTEN, SHADE_GOURAUD>>;
+	}
+}
+
+/**
+ * Recomputes the maximum depth of a depth tile.
+ */
+void Rasterizer::updateDepthTile(int tile) {
+	depthTileMaxima[tile] = depthFormat == DEPTH_16 ? getTileMaxDepth<Depth16>(tile) : getTileMaxDepth<Depth32>(tile);
+	depthTileWrites[tile] = 0;
+}
+
+template<typename Depth>
+int Rasterizer::getTileMaxDepth(int tile) {
+	int left = (tile % depthTileColumns) * DEPTH_TILE_SIZE;
+	int top = (tile / depthTileColumns) * DEPTH_TILE_SIZE;
+	int right = std::min(left + DEPTH_TILE_SIZE, width);
+	int bottom = std::min(top + DEPTH_TILE_SIZE, height);
+	typename Depth::Value maxDepth = 0;
+
+	for (int y = top; y < bottom; y++) {
+		const typename Depth::Value* row = (const typename Depth::Value*)depthBuffer + y * width;
+
+		for (int x = left; x < right; x++) {
+			maxDepth = std::max(maxDepth, row[x]);
+		}
+	}
+
+	return Depth::decode(maxDepth);
 }
 
 void Rasterizer::triangle(int x1, int y1, int x2, int y2, int x3, int y3) {
@@ -148,12 +1279,123 @@ void Rasterizer::triangle(int x1, int y1, int x2, int y2, int x3, int y3) {
 }
 
 /**
- * Rasterize a filled triangle with per-vertex coloration.
+ * Rasterizes a triangle with the current state.
  */
 void Rasterizer::triangle(Triangle& triangle) {
-	Vertex2d* top = &triangle.vertices[0];
-	Vertex2d* middle = &triangle.vertices[1];
-	Vertex2d* bottom = &triangle.vertices[2];
+	if (threadPool != NULL) {
+		binTriangle(triangle);
+	} else if (depthPassFunction != NULL) {
+		(this->*depthPassFunction)(triangle, { 0, 0, width, height });
+
+		binnedTriangles.push_back(triangle);
+	} else if (!(this->*rasterizeFunction)(triangle, { 0, 0, width, height })) {
+		occludedTriangleCount.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+/**
+ * Rasterizes the part of a filled triangle which lies within the
+ * clipping region, unless it's depth tested and entirely occluded.
+ */
+template<typename Depth, TriangleTraversal TRAVERSAL, typename Pipeline>
+bool Rasterizer::rasterizeTriangle(const Triangle& triangle, const Rect& clip) {
+	if (Pipeline::SHADING == SHADE_TEXTURED && triangle.texture == NULL) {
+		return rasterizeTriangle<Depth, TRAVERSAL, typename Pipeline::Untextured>(triangle, clip);
+	}
+
+	const Vertex2d& v1 = triangle.vertices[0];
+	const Vertex2d& v2 = triangle.vertices[1];
+	const Vertex2d& v3 = triangle.vertices[2];
+	Rect bounds;
+
+	bounds.left = std::max(std::min({ v1.coordinate.x, v2.coordinate.x, v3.coordinate.x }), clip.left);
+	bounds.right = std::min(std::max({ v1.coordinate.x, v2.coordinate.x, v3.coordinate.x }) + 1, clip.right);
+	bounds.top = std::max(std::min({ v1.coordinate.y, v2.coordinate.y, v3.coordinate.y }), clip.top);
+	bounds.bottom = std::min(std::max({ v1.coordinate.y, v2.coordinate.y, v3.coordinate.y }) + 1, clip.bottom);
+
+	if (Pipeline::DEPTH_TEST != DEPTH_ALWAYS && isOccluded(bounds, std::min({ v1.depth, v2.depth, v3.depth }))) {
+		return false;
+	}
+
+	prepareTiles(bounds);
+
+	if (TRAVERSAL == HALF_SPACE_TRAVERSAL) {
+		halfSpaceTriangle<Depth, Pipeline>(triangle, clip);
+	} else {
+		scanLineTriangle<Depth, Pipeline>(triangle, clip);
+	}
+
+	if (Pipeline::IS_DEPTH_WRITTEN) {
+		invalidateDepthTiles(bounds, Pipeline::DEPTH_TEST != DEPTH_ALWAYS);
+	}
+
+	return true;
+}
+
+/**
+ * Rasterizes the edges of a triangle within the clipping region. When
+ * depth testing, the triangle's surface is first filled with the clear
+ * color, covering edges behind it. Edges are then tested with a bias
+ * of the surface's depth slope, which covers the difference between
+ * depths sampled along an edge and at the surrounding pixel centers.
+ */
+template<typename Depth, TriangleTraversal TRAVERSAL, bool IS_DEPTH_TESTED>
+bool Rasterizer::rasterizeWireframe(const Triangle& triangle, const Rect& clip) {
+	const Vertex2d& v1 = triangle.vertices[0];
+	const Vertex2d& v2 = triangle.vertices[1];
+	const Vertex2d& v3 = triangle.vertices[2];
+
+	if (!IS_DEPTH_TESTED) {
+		clippedLine<Depth, false>(v1, v2, 0, clip);
+		clippedLine<Depth, false>(v2, v3, 0, clip);
+		clippedLine<Depth, false>(v3, v1, 0, clip);
+
+		return true;
+	}
+
+	Triangle surface = triangle;
+
+	surface.vertices[0].color = { 0, 0, 0 };
+
+	bool isSurfaceVisible = rasterizeTriangle<Depth, TRAVERSAL, Pipeline<DEPTH_LESS, true, SHADE_FLAT>>(surface, clip);
+
+	float x21 = (float)(v2.coordinate.x - v1.coordinate.x);
+	float y21 = (float)(v2.coordinate.y - v1.coordinate.y);
+	float x31 = (float)(v3.coordinate.x - v1.coordinate.x);
+	float y31 = (float)(v3.coordinate.y - v1.coordinate.y);
+	float area = x21 * y31 - x31 * y21;
+	float depthBias = 1.0f;
+
+	if (area != 0) {
+		float z21 = (float)(v2.depth - v1.depth);
+		float z31 = (float)(v3.depth - v1.depth);
+
+		depthBias += (std::abs(z21 * y31 - z31 * y21) + std::abs(z31 * x21 - z21 * x31)) / std::abs(area);
+	}
+
+	clippedLine<Depth, true>(v1, v2, depthBias, clip);
+	clippedLine<Depth, true>(v2, v3, depthBias, clip);
+	clippedLine<Depth, true>(v3, v1, depthBias, clip);
+
+	return isSurfaceVisible;
+}
+
+/**
+ * Rasterizes a filled triangle by splitting it into flat-bottom
+ * and flat-top halves, and filling each row by row.
+ */
+template<typename Depth, typename Pipeline>
+void Rasterizer::scanLineTriangle(const Triangle& triangle, const Rect& clip) {
+	const Color& flatColor = triangle.vertices[0].color;
+	TextureMapping mapping;
+
+	if (Pipeline::SHADING == SHADE_TEXTURED) {
+		mapping = TextureMapping(triangle);
+	}
+
+	const Vertex2d* top = &triangle.vertices[0];
+	const Vertex2d* middle = &triangle.vertices[1];
+	const Vertex2d* bottom = &triangle.vertices[2];
 
 	if (top->coordinate.y > middle->coordinate.y) {
 		std::swap(top, middle);
@@ -167,7 +1409,7 @@ void Rasterizer::triangle(Triangle& triangle) {
 		std::swap(top, middle);
 	}
 
-	if (top->coordinate.y >= height || bottom->coordinate.y < 0) {
+	if (top->coordinate.y >= clip.bottom || bottom->coordinate.y < clip.top) {
 		// Optimize for vertically offscreen triangles
 		return;
 	}
@@ -177,32 +1419,32 @@ void Rasterizer::triangle(Triangle& triangle) {
 			std::swap(top, middle);
 		}
 
-		flatTopTriangle(*top, *middle, *bottom);
+		flatTriangle<Depth, Pipeline>(*bottom, *top, *middle, flatColor, &mapping, clip);
 	} else if (bottom->coordinate.y == middle->coordinate.y) {
 		if (bottom->coordinate.x < middle->coordinate.x) {
 			std::swap(bottom, middle);
 		}
 
-		flatBottomTriangle(*top, *middle, *bottom);
+		flatTriangle<Depth, Pipeline>(*top, *middle, *bottom, flatColor, &mapping, clip);
 	} else {
-		float hypotenuseSlope = (float)(bottom->coordinate.y - top->coordinate.y) / (bottom->coordinate.x - top->coordinate.x);
+		float hypotenuseInverseSlope = (float)(bottom->coordinate.x - top->coordinate.x) / (bottom->coordinate.y - top->coordinate.y);
 		float middleYProgress = (float)(middle->coordinate.y - top->coordinate.y) / (bottom->coordinate.y - top->coordinate.y);
 
 		Vertex2d middleOpposite;
 
-		middleOpposite.coordinate = { top->coordinate.x + (int)((middle->coordinate.y - top->coordinate.y) / hypotenuseSlope), middle->coordinate.y };
+		middleOpposite.coordinate = { top->coordinate.x + (int)((middle->coordinate.y - top->coordinate.y) * hypotenuseInverseSlope), middle->coordinate.y };
 		middleOpposite.depth = lerp(top->depth, bottom->depth, middleYProgress);
 		middleOpposite.color = lerp(top->color, bottom->color, middleYProgress);
 
-		Vertex2d* middleLeft = middle;
-		Vertex2d* middleRight = &middleOpposite;
+		const Vertex2d* middleLeft = middle;
+		const Vertex2d* middleRight = &middleOpposite;
 
 		if (middleLeft->coordinate.x > middleRight->coordinate.x) {
 			std::swap(middleLeft, middleRight);
 		}
 
-		flatBottomTriangle(*top, *middleLeft, *middleRight);
-		flatTopTriangle(*middleLeft, *middleRight, *bottom);
+		flatTriangle<Depth, Pipeline>(*top, *middleLeft, *middleRight, flatColor, &mapping, clip);
+		flatTriangle<Depth, Pipeline>(*bottom, *middleLeft, *middleRight, flatColor, &mapping, clip);
 	}
 }
 
@@ -213,8 +1455,9 @@ void Rasterizer::triangle(Triangle& triangle) {
  * of the system, and care must be taken to ensure that it includes
  * no unnecessary work.
  */
-void Rasterizer::triangleScanLine(int x1, int y1, int lineLength, const Color& leftColor, const Color& rightColor, int leftDepth, int rightDepth) {
-	if (y1 >= height || y1 < 0 || lineLength == 0) {
+template<typename Depth, typename Pipeline>
+void Rasterizer::triangleScanLine(int x1, int y1, int lineLength, const Color& leftColor, const Color& rightColor, int leftDepth, int rightDepth, const TextureMapping* mapping, const Rect& clip) {
+	if (y1 >= clip.bottom || y1 < clip.top || lineLength == 0) {
 		// Optimize for vertically offscreen lines or zero-length
 		// lines. Most horizontally offscreen lines are automatically
 		// avoided by preemptively checking the left and right edges
@@ -225,29 +1468,108 @@ void Rasterizer::triangleScanLine(int x1, int y1, int lineLength, const Color& l
 		return;
 	}
 
-	int start = std::max(x1, 0);
-	int end = std::min(x1 + lineLength, width - 1);
-	int pixelIndexOffset = y1 * width;
+	int start = std::max(x1, clip.left);
+	int end = std::min(x1 + lineLength, clip.right - 1);
+	Uint32* pixels = pixelBuffer + y1 * pixelPitch;
+	typename Depth::Value* depths = (typename Depth::Value*)depthBuffer + y1 * width;
+
+	if (start > end) {
+		return;
+	}
+
+	// Colors and depths are stepped in fixed point from the start of
+	// the line, so the pixel loop only needs integer adds. Clipped
+	// lines skip ahead by whole steps, so that every pixel has the
+	// same value however the line is clipped, e.g. across tiles.
+	float inverseLength = 1.0f / lineLength;
+	int offset = start - x1;
+	Uint32 flatPixel = leftColor.value;
+	FixedColor shadedColor = { };
+	FixedColor colorStep = { };
+	long long depth = 0;
+	long long depthStep = 0;
+	const TextureLevel* level = NULL;
+	float uOverW = 0.0f;
+	float vOverW = 0.0f;
+	float inverseW = 0.0f;
+	int writtenPixels = 0;
+
+	if (Pipeline::IS_DEPTH_USED) {
+		float depthSlope = (rightDepth - leftDepth) * inverseLength;
+
+		depthStep = toFixed(depthSlope);
+		depth = ((long long)leftDepth << FIXED_POINT_BITS) + depthStep * offset;
+	}
+
+	if (Pipeline::SHADING == SHADE_GOURAUD) {
+		float redSlope = (rightColor.getR() - leftColor.getR()) * inverseLength;
+		float greenSlope = (rightColor.getG() - leftColor.getG()) * inverseLength;
+		float blueSlope = (rightColor.getB() - leftColor.getB()) * inverseLength;
+
+		colorStep = FixedColor::createStep(redSlope, greenSlope, blueSlope);
+		shadedColor = FixedColor::create(leftColor.getR(), leftColor.getG(), leftColor.getB());
+		shadedColor.step(colorStep, offset);
+	}
+
+	if (Pipeline::SHADING == SHADE_TEXTURED) {
+		level = &mapping->selectLevel((start + end) / 2, y1);
+		uOverW = mapping->u.at(start, y1);
+		vOverW = mapping->v.at(start, y1);
+		inverseW = mapping->inverseW.at(start, y1);
+	}
 
 	for (int x = start; x <= end; x++) {
-		float progress = (float)(x - x1) / lineLength;
-		int depth = lerp(leftDepth, rightDepth, progress);
-		int index = pixelIndexOffset + x;
+		typename Depth::Value encodedDepth = Pipeline::IS_DEPTH_USED ? Depth::encode((int)(depth >> FIXED_POINT_BITS)) : 0;
+
+		if (Pipeline::DEPTH_TEST == DEPTH_ALWAYS || Pipeline::isVisible(encodedDepth, depths[x])) {
+			if (Pipeline::SHADING == SHADE_GOURAUD) {
+				// We refrain from calling setColor() here, to keep
+				// the shared color out of the pixel path when
+				// rasterizing tiles in parallel
+				pixels[x] = shadedColor.toPixel();
+			} else if (Pipeline::SHADING == SHADE_FLAT) {
+				pixels[x] = flatPixel;
+			} else if (Pipeline::SHADING == SHADE_TEXTURED) {
+				float w = 1.0f / inverseW;
 
-		if (depthBuffer[index] > depth) {
-			// Lerping the color components individually is more
-			// efficient than lerping leftColor -> rightColor and
-			// generating a new Color object each time
-			int R = lerp(leftColor.R, rightColor.R, progress);
-			int G = lerp(leftColor.G, rightColor.G, progress);
-			int B = lerp(leftColor.B, rightColor.B, progress);
+				pixels[x] = level->sample(uOverW * w, vOverW * w);
+			}
 
-			setColor(R, G, B);
+			if (Pipeline::IS_DEPTH_WRITTEN) {
+				depths[x] = encodedDepth;
+			}
 
-			// We refrain from calling setPixel() here to avoid
-			// its additional redunant calculation of the index
-			pixelBuffer[index] = color;
-			depthBuffer[index] = depth;
+			writtenPixels += Pipeline::SHADING != SHADE_NONE;
+		}
+
+		depth += depthStep;
+		shadedColor.step(colorStep);
+
+		if (Pipeline::SHADING == SHADE_TEXTURED) {
+			uOverW += mapping->u.stepX;
+			vOverW += mapping->v.stepX;
+			inverseW += mapping->inverseW.stepX;
 		}
 	}
-}
\ No newline at end of file
+
+	PROFILE_COUNT(PROFILE_PIXELS_TESTED, end - start + 1);
+	PROFILE_COUNT(PROFILE_PIXELS_WRITTEN, writtenPixels);
+}
+
+/**
+ * Rasterizes a depth tested, Gouraud shaded scanline in the current
+ * depth format.
+ */
+void Rasterizer::triangleScanLine(int x1, int y1, int lineLength, const Color& leftColor, const Color& rightColor, int leftDepth, int rightDepth, const Rect& clip) {
+	typedef Pipeline<DEPTH_LESS, true, SHADE_GOURAUD> GouraudPipeline;
+
+	if (depthFormat == DEPTH_16) {
+		triangleScanLine<Depth16, GouraudPipeline>(x1, y1, lineLength, leftColor, rightColor, leftDepth, rightDepth, NULL, clip);
+	} else {
+		triangleScanLine<Depth32, GouraudPipeline>(x1, y1, lineLength, leftColor, rightColor, leftDepth, rightDepth, NULL, clip);
+	}
+}
+
+Uint32 Rasterizer::toPixel(int R, int G, int B) {
+	return (255 << 24) | (R << 16) | (G << 8) | B;
+}
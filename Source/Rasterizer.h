@@ -1,29 +1,209 @@
 #pragma once
 
 #include <SDL.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <Types.h>
+#include <RenderTarget.h>
+#include <ThreadPool.h>
+
+/**
+ * A screen-space region used to restrict rasterization. The right
+ * and bottom edges are exclusive.
+ */
+struct Rect {
+	int left = 0;
+	int top = 0;
+	int right = 0;
+	int bottom = 0;
+};
+
+/**
+ * Strategies for visiting the pixels covered by a filled triangle.
+ */
+enum TriangleTraversal {
+	SCANLINE_TRAVERSAL,
+	HALF_SPACE_TRAVERSAL
+};
+
+/**
+ * Comparisons made between the depths of drawn pixels and the depth
+ * buffer. Pixels always pass when depth testing is disabled.
+ */
+enum DepthTest {
+	DEPTH_ALWAYS,
+	DEPTH_LESS,
+	DEPTH_EQUAL
+};
+
+/**
+ * Ways of coloring the pixels of filled triangles. Flat triangles are
+ * colored by their first vertex, Gouraud triangles interpolate their
+ * vertex colors, and unshaded triangles only draw depths. Textured
+ * shading samples each triangle's texture, and falls back to Gouraud
+ * shading for triangles without one.
+ */
+enum Shading {
+	SHADE_NONE,
+	SHADE_FLAT,
+	SHADE_GOURAUD,
+	SHADE_TEXTURED
+};
+
+/**
+ * The state triangles are drawn with. Each combination selects its own
+ * rasterization path, specialized at compile time, so that triangles
+ * only pay for the features they use. Wireframe triangles draw their
+ * edges in the current color, which are hidden behind other triangles
+ * unless depth testing is disabled.
+ */
+struct RasterState {
+	DepthTest depthTest = DEPTH_LESS;
+	bool isDepthWritten = true;
+	Shading shading = SHADE_GOURAUD;
+	bool isWireframe = false;
+};
+
+/**
+ * Storage formats for depth values. The compact format halves depth
+ * buffer traffic, at the expense of depth precision.
+ */
+enum DepthFormat {
+	DEPTH_32,
+	DEPTH_16
+};
+
+/**
+ * Ways of handing finished frames to the render target. Copied frames
+ * are drawn into the rasterizer's own buffers, and copied by the
+ * target when presented. Direct frames are drawn straight into memory
+ * locked from the target, saving a full-frame copy per frame.
+ */
+enum PresentMode {
+	PRESENT_COPY,
+	PRESENT_DIRECT
+};
 
 class Rasterizer {
 	public:
-		Rasterizer(SDL_Renderer* renderer, int width, int height);
+		Rasterizer(RenderTarget* target, int width, int height);
 		~Rasterizer();
+		void enableBinning(int threadCount);
+		void enablePresentThread(int bufferCount);
+		void finish();
+		int getOccludedTriangleCount();
+		PresentMode getPresentMode();
+		bool isOccluded(const Rect& bounds, int minDepth);
 		void line(int x1, int y1, int x2, int y2);
-		void render(SDL_Renderer* renderer);
+		void render();
 		void setColor(int R, int G, int B);
 		void setColor(Color* color);
+		void setDepthFormat(DepthFormat depthFormat);
+		void setDepthPrepass(bool isEnabled);
+		void setPresentMode(PresentMode presentMode);
+		void setState(const RasterState& state);
+		void setTraversal(TriangleTraversal traversal);
 		void triangle(int x1, int y1, int x2, int y2, int x3, int y3);
 		void triangle(Triangle& triangle);
 	private:
-		SDL_Texture* screenTexture;
+		friend class RasterizerBenchmark;
+
+		/**
+		 * Rasterizes the part of a triangle within a clipping region,
+		 * returning false if it was occluded.
+		 */
+		typedef bool (Rasterizer::*RasterizeFunction)(const Triangle& triangle, const Rect& clip);
+
+		struct TextureMapping;
+
+		constexpr static int TILE_SIZE = 64;
+		constexpr static int BLOCK_SIZE = 8;
+		constexpr static int DEPTH_TILE_SIZE = 16;
+		constexpr static int DEPTH_TILE_RESCAN_WRITES = 8;
+		RenderTarget* target;
+		ThreadPool* threadPool = NULL;
+
+		// Binned triangles, or without binning, triangles deferred
+		// to the color pass of a depth prepass
+		std::vector<Triangle> binnedTriangles;
+		std::vector<std::vector<int>> bins;
+
+		/**
+		 * A pixel buffer and depth buffer, along with the clear state
+		 * of each of their DEPTH_TILE_SIZE x DEPTH_TILE_SIZE tiles.
+		 * Tiles are only cleared the first time they're drawn into
+		 * during a frame, or when they're left undrawn but still hold
+		 * an earlier frame's pixels.
+		 */
+		struct BufferSet {
+			Uint32* pixels;
+			Uint8* depths;
+			std::vector<int> tileEpochs;
+			std::vector<Uint8> dirtyTiles;
+		};
+
 		Uint32* pixelBuffer;
-		int* depthBuffer;
+		int pixelPitch;
+		Uint8* depthBuffer;
+		std::vector<BufferSet> bufferSets;
+		int currentBufferSet = 0;
+		int frameEpoch = 0;
+		DepthFormat depthFormat = DEPTH_32;
+		PresentMode presentMode = PRESENT_COPY;
+		bool isDirectFrame = false;
+		std::thread presentThread;
+		std::mutex presentMutex;
+		std::condition_variable presentCondition;
+		int submittedFrames = 0;
+		int presentedFrames = 0;
+		bool isStopping = false;
+		std::vector<int> depthTileMaxima;
+		std::vector<Uint8> depthTileWrites;
 		long int color;
+		std::atomic<int> occludedTriangleCount { 0 };
+		int lastOccludedTriangleCount = 0;
+		TriangleTraversal traversal = SCANLINE_TRAVERSAL;
+		RasterState state;
+		bool isDepthPrepassEnabled = false;
+		RasterizeFunction rasterizeFunction = NULL;
+		RasterizeFunction depthPassFunction = NULL;
 		int width;
 		int height;
-		void clear();
-		void flatTriangle(const Vertex2d& corner, const Vertex2d& left, const Vertex2d& right);
-		void flatBottomTriangle(const Vertex2d& top, const Vertex2d& bottomLeft, const Vertex2d& bottomRight);
-		void flatTopTriangle(const Vertex2d& topLeft, const Vertex2d& topRight, const Vertex2d& bottom);
-		void triangleScanLine(int x1, int y1, int width, const Color& startColor, const Color& endColor, int leftDepth, int rightDepth);
-		void setPixel(int x, int y, int depth = 1);
-};
\ No newline at end of file
+		int tileColumns;
+		int tileRows;
+		int depthTileColumns;
+		int depthTileRows;
+		void addBufferSet();
+		void beginFrame();
+		void binTriangle(const Triangle& triangle);
+		void clearStaleTiles();
+		void clearBufferSet(BufferSet& buffers);
+		void clearTile(int tile);
+		void clearTile(Uint32* pixels, int pitch, Uint8* depths, int tile);
+		template<typename Depth, typename Pipeline> void flatTriangle(const Vertex2d& corner, const Vertex2d& left, const Vertex2d& right, const Color& flatColor, const TextureMapping* mapping, const Rect& clip);
+		void flushBins();
+		void flushColorPass();
+		Rect getTileRect(int tile);
+		void invalidateDepthTiles(const Rect& bounds, bool isDepthTested);
+		void presentFrames();
+		template<typename Depth, bool IS_DEPTH_TESTED> void clippedLine(const Vertex2d& start, const Vertex2d& end, float depthBias, const Rect& clip);
+		void prepareTile(int tile);
+		void prepareTiles(const Rect& bounds);
+		template<typename Depth, typename Pipeline> void halfSpaceTriangle(const Triangle& triangle, const Rect& clip);
+		template<typename Depth, TriangleTraversal TRAVERSAL, typename Pipeline> bool rasterizeTriangle(const Triangle& triangle, const Rect& clip);
+		template<typename Depth, TriangleTraversal TRAVERSAL, bool IS_DEPTH_TESTED> bool rasterizeWireframe(const Triangle& triangle, const Rect& clip);
+		template<typename Depth, typename Pipeline> void scanLineTriangle(const Triangle& triangle, const Rect& clip);
+		void selectPipelines();
+		RasterizeFunction selectRasterizer(const RasterState& state);
+		template<typename Depth> RasterizeFunction selectTraversal(const RasterState& state);
+		template<typename Depth, TriangleTraversal TRAVERSAL> RasterizeFunction selectDepthTest(const RasterState& state);
+		template<typename Depth, TriangleTraversal TRAVERSAL, DepthTest DEPTH_TEST, bool IS_DEPTH_WRITTEN> RasterizeFunction selectShading(Shading shading);
+		void triangleScanLine(int x1, int y1, int width, const Color& startColor, const Color& endColor, int leftDepth, int rightDepth, const Rect& clip);
+		template<typename Depth, typename Pipeline> void triangleScanLine(int x1, int y1, int width, const Color& startColor, const Color& endColor, int leftDepth, int rightDepth, const TextureMapping* mapping, const Rect& clip);
+		void updateDepthTile(int tile);
+		template<typename Depth> int getTileMaxDepth(int tile);
+		static Uint32 toPixel(int R, int G, int B);
+};
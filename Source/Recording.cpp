@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <Recording.h>
+
+void Recording::addFrame(const CameraPose& pose) {
+	frames.push_back(pose);
+}
+
+int Recording::getFrameCount() const {
+	return frames.size();
+}
+
+const CameraPose& Recording::getFrame(int frame) const {
+	return frames.at(frame);
+}
+
+/**
+ * Loads a recording saved by save(), replacing any frames already
+ * recorded. Returns false if the file can't be read or isn't a
+ * recording of a supported version.
+ */
+bool Recording::load(const char* path) {
+	FILE* file = fopen(path, "r");
+
+	if (file == NULL) {
+		return false;
+	}
+
+	char magic[32];
+	int version = 0;
+	int frameCount = 0;
+
+	bool isValid = (
+		fscanf(file, "%31s %d", magic, &version) == 2 &&
+		strcmp(magic, "softengine-recording") == 0 &&
+		version == VERSION &&
+		fscanf(file, " seed %u size %d %d frames %d", &seed, &width, &height, &frameCount) == 4 &&
+		frameCount >= 0
+	);
+
+	frames.clear();
+
+	for (int i = 0; isValid && i < frameCount; i++) {
+		CameraPose pose;
+
+		isValid = fscanf(
+			file, "%f %f %f %f %f %f",
+			&pose.position.x, &pose.position.y, &pose.position.z,
+			&pose.rotation.x, &pose.rotation.y, &pose.rotation.z
+		) == 6;
+
+		frames.push_back(pose);
+	}
+
+	fclose(file);
+
+	return isValid;
+}
+
+/**
+ * Saves the recording as text, with one line per frame. Components
+ * are written with enough digits to be read back exactly.
+ */
+bool Recording::save(const char* path) const {
+	FILE* file = fopen(path, "w");
+
+	if (file == NULL) {
+		return false;
+	}
+
+	fprintf(file, "softengine-recording %d\n", VERSION);
+	fprintf(file, "seed %u\nsize %d %d\nframes %d\n", seed, width, height, (int)frames.size());
+
+	for (const CameraPose& pose : frames) {
+		fprintf(
+			file, "%.9g %.9g %.9g %.9g %.9g %.9g\n",
+			pose.position.x, pose.position.y, pose.position.z,
+			pose.rotation.x, pose.rotation.y, pose.rotation.z
+		);
+	}
+
+	bool isWritten = ferror(file) == 0;
+
+	return fclose(file) == 0 && isWritten;
+}
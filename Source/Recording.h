@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <Types.h>
+
+/**
+ * The camera's placement during a single frame.
+ */
+struct CameraPose {
+	Vec3 position;
+	Vec3 rotation;
+};
+
+/**
+ * A captured session: the seed and screen size its scene was built
+ * with, and the camera's pose during each frame. Replaying the poses
+ * in a scene built the same way reproduces every frame exactly,
+ * regardless of how quickly the original session ran.
+ */
+class Recording {
+	public:
+		uint32_t seed = 0;
+		int width = 0;
+		int height = 0;
+
+		void addFrame(const CameraPose& pose);
+		int getFrameCount() const;
+		const CameraPose& getFrame(int frame) const;
+		bool load(const char* path);
+		bool save(const char* path) const;
+	private:
+		constexpr static int VERSION = 1;
+		std::vector<CameraPose> frames;
+};
@@ -0,0 +1,257 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include <RenderTarget.h>
+
+/**
+ * Creates the renderer and screen texture. Renderers which don't
+ * support streaming textures get a static one, which can only be
+ * updated by copying frames into it.
+ */
+SDLRenderTarget::SDLRenderTarget(SDL_Window* window, int width, int height, Uint32 rendererFlags) {
+	renderer = SDL_CreateRenderer(window, -1, rendererFlags);
+	screenTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width, height);
+
+	if (screenTexture == NULL) {
+		screenTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, width, height);
+	}
+}
+
+SDLRenderTarget::~SDLRenderTarget() {
+	if (renderer != NULL) {
+		SDL_DestroyTexture(screenTexture);
+		SDL_DestroyRenderer(renderer);
+	}
+}
+
+bool SDLRenderTarget::isThreadBound() {
+	return true;
+}
+
+Uint32* SDLRenderTarget::lock(int width, int height, int* pitch) {
+	void* pixels;
+	int bytePitch;
+
+	if (lockedPixels == NULL && SDL_LockTexture(screenTexture, NULL, &pixels, &bytePitch) == 0) {
+		lockedPixels = (Uint32*)pixels;
+		lockedPitch = bytePitch / sizeof(Uint32);
+	}
+
+	*pitch = lockedPitch;
+
+	return lockedPixels;
+}
+
+void SDLRenderTarget::present(const Uint32* pixels, int width, int height) {
+	if (lockedPixels != NULL) {
+		SDL_UnlockTexture(screenTexture);
+	}
+
+	if (pixels != lockedPixels) {
+		SDL_UpdateTexture(screenTexture, NULL, pixels, width * sizeof(Uint32));
+	}
+
+	lockedPixels = NULL;
+
+	SDL_RenderCopy(renderer, screenTexture, NULL, NULL);
+	SDL_RenderPresent(renderer);
+}
+
+FramebufferTarget::FramebufferTarget(int width, int height) {
+	this->width = width;
+	this->height = height;
+
+	frame = new Uint32[width * height];
+
+	std::fill(frame, frame + width * height, 0);
+}
+
+FramebufferTarget::~FramebufferTarget() {
+	delete[] frame;
+}
+
+int FramebufferTarget::getFrameCount() const {
+	return frameCount;
+}
+
+const Uint32* FramebufferTarget::getPixels() const {
+	return frame;
+}
+
+/**
+ * Lets frames be drawn straight into the stored frame.
+ */
+Uint32* FramebufferTarget::lock(int width, int height, int* pitch) {
+	*pitch = this->width;
+
+	return frame;
+}
+
+void FramebufferTarget::present(const Uint32* pixels, int width, int height) {
+	if (pixels != frame) {
+		std::copy(pixels, pixels + width * height, frame);
+	}
+
+	frameCount++;
+}
+
+/**
+ * Saves the last presented frame, choosing PNG or PPM output
+ * based on the extension of the provided path.
+ */
+bool FramebufferTarget::save(const char* path) const {
+	const char* extension = strrchr(path, '.');
+
+	if (extension != NULL && strcmp(extension, ".ppm") == 0) {
+		return savePPM(path);
+	}
+
+	return savePNG(path);
+}
+
+namespace {
+	Uint32 crc32(const Uint8* data, size_t length, Uint32 crc = 0) {
+		static Uint32 table[256];
+		static bool hasTable = false;
+
+		if (!hasTable) {
+			for (Uint32 n = 0; n < 256; n++) {
+				Uint32 c = n;
+
+				for (int k = 0; k < 8; k++) {
+					c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+				}
+
+				table[n] = c;
+			}
+
+			hasTable = true;
+		}
+
+		crc = ~crc;
+
+		for (size_t i = 0; i < length; i++) {
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+
+		return ~crc;
+	}
+
+	void appendBigEndian(std::vector<Uint8>& bytes, Uint32 value) {
+		bytes.push_back((value >> 24) & 0xFF);
+		bytes.push_back((value >> 16) & 0xFF);
+		bytes.push_back((value >> 8) & 0xFF);
+		bytes.push_back(value & 0xFF);
+	}
+
+	void writeChunk(FILE* file, const char* type, const std::vector<Uint8>& data) {
+		std::vector<Uint8> chunk;
+
+		appendBigEndian(chunk, data.size());
+		chunk.insert(chunk.end(), type, type + 4);
+		chunk.insert(chunk.end(), data.begin(), data.end());
+		appendBigEndian(chunk, crc32(&chunk[4], chunk.size() - 4));
+
+		fwrite(chunk.data(), 1, chunk.size(), file);
+	}
+}
+
+/**
+ * Writes the frame as an 8-bit RGB PNG. The image data is stored in
+ * uncompressed deflate blocks, which keeps the encoder dependency-free
+ * at the expense of file size.
+ */
+bool FramebufferTarget::savePNG(const char* path) const {
+	FILE* file = fopen(path, "wb");
+
+	if (file == NULL) {
+		return false;
+	}
+
+	const Uint8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	std::vector<Uint8> header;
+
+	appendBigEndian(header, width);
+	appendBigEndian(header, height);
+	header.push_back(8);	// Bit depth
+	header.push_back(2);	// Color type (RGB)
+	header.push_back(0);	// Compression method
+	header.push_back(0);	// Filter method
+	header.push_back(0);	// Interlace method
+
+	// Each scanline is prefixed with its filter type (none)
+	std::vector<Uint8> raw;
+
+	raw.reserve(height * (1 + width * 3));
+
+	for (int y = 0; y < height; y++) {
+		raw.push_back(0);
+
+		for (int x = 0; x < width; x++) {
+			Uint32 pixel = frame[y * width + x];
+
+			raw.push_back((pixel >> 16) & 0xFF);
+			raw.push_back((pixel >> 8) & 0xFF);
+			raw.push_back(pixel & 0xFF);
+		}
+	}
+
+	std::vector<Uint8> compressed = { 0x78, 0x01 };
+	Uint32 adlerA = 1;
+	Uint32 adlerB = 0;
+
+	for (size_t i = 0; i < raw.size(); i++) {
+		adlerA = (adlerA + raw[i]) % 65521;
+		adlerB = (adlerB + adlerA) % 65521;
+	}
+
+	for (size_t offset = 0; offset < raw.size(); offset += 65535) {
+		size_t blockLength = std::min(raw.size() - offset, (size_t)65535);
+		bool isFinalBlock = offset + blockLength == raw.size();
+
+		compressed.push_back(isFinalBlock ? 1 : 0);
+		compressed.push_back(blockLength & 0xFF);
+		compressed.push_back((blockLength >> 8) & 0xFF);
+		compressed.push_back(~blockLength & 0xFF);
+		compressed.push_back((~blockLength >> 8) & 0xFF);
+		compressed.insert(compressed.end(), raw.begin() + offset, raw.begin() + offset + blockLength);
+	}
+
+	appendBigEndian(compressed, (adlerB << 16) | adlerA);
+
+	fwrite(signature, 1, sizeof(signature), file);
+	writeChunk(file, "IHDR", header);
+	writeChunk(file, "IDAT", compressed);
+	writeChunk(file, "IEND", {});
+
+	return fclose(file) == 0;
+}
+
+/**
+ * Writes the frame as a binary (P6) PPM.
+ */
+bool FramebufferTarget::savePPM(const char* path) const {
+	FILE* file = fopen(path, "wb");
+
+	if (file == NULL) {
+		return false;
+	}
+
+	fprintf(file, "P6\n%d %d\n255\n", width, height);
+
+	for (int i = 0; i < width * height; i++) {
+		Uint8 rgb[3] = {
+			(Uint8)((frame[i] >> 16) & 0xFF),
+			(Uint8)((frame[i] >> 8) & 0xFF),
+			(Uint8)(frame[i] & 0xFF)
+		};
+
+		fwrite(rgb, 1, 3, file);
+	}
+
+	return fclose(file) == 0;
+}
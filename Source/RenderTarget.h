@@ -0,0 +1,79 @@
+#pragma once
+
+#include <SDL.h>
+
+/**
+ * A destination for finished frames. The Rasterizer draws into its
+ * own pixel buffers, and hands each completed frame to a RenderTarget
+ * for presentation. Frames may be presented from a thread other than
+ * the one which created the target, but only ever from one thread,
+ * unless the target is bound to its creating thread.
+ */
+class RenderTarget {
+	public:
+		virtual ~RenderTarget() {}
+
+		/**
+		 * Provides memory for the next frame to be drawn into directly,
+		 * and sets the pitch of its rows in pixels. Its contents are
+		 * undefined until drawn. The frame is then passed to present()
+		 * as usual. Targets which can't provide memory return NULL,
+		 * and frames are drawn into separate buffers and copied.
+		 */
+		virtual Uint32* lock(int width, int height, int* pitch) {
+			return NULL;
+		}
+
+		virtual void present(const Uint32* pixels, int width, int height) = 0;
+
+		/**
+		 * Returns whether lock() and present() may only be called
+		 * from the thread which created the target.
+		 */
+		virtual bool isThreadBound() {
+			return false;
+		}
+};
+
+/**
+ * Presents frames to an SDL window via a screen-sized streaming
+ * texture, which frames can be drawn into directly while it's locked.
+ * SDL renderers may only be used from the thread which created their
+ * window, so the renderer and texture are created along with the
+ * target, and frames must be uploaded and presented from that thread.
+ */
+class SDLRenderTarget : public RenderTarget {
+	public:
+		SDLRenderTarget(SDL_Window* window, int width, int height, Uint32 rendererFlags);
+		~SDLRenderTarget();
+		bool isThreadBound() override;
+		Uint32* lock(int width, int height, int* pitch) override;
+		void present(const Uint32* pixels, int width, int height) override;
+	private:
+		SDL_Renderer* renderer = NULL;
+		SDL_Texture* screenTexture = NULL;
+		Uint32* lockedPixels = NULL;
+		int lockedPitch = 0;
+};
+
+/**
+ * Keeps the most recently presented frame in memory, allowing frames
+ * to be rendered, inspected and saved without a display.
+ */
+class FramebufferTarget : public RenderTarget {
+	public:
+		FramebufferTarget(int width, int height);
+		~FramebufferTarget();
+		int getFrameCount() const;
+		const Uint32* getPixels() const;
+		Uint32* lock(int width, int height, int* pitch) override;
+		void present(const Uint32* pixels, int width, int height) override;
+		bool save(const char* path) const;
+		bool savePNG(const char* path) const;
+		bool savePPM(const char* path) const;
+	private:
+		Uint32* frame;
+		int frameCount = 0;
+		int width;
+		int height;
+};
@@ -0,0 +1,326 @@
+#include <math.h>
+#include <algorithm>
+
+#include <Random.h>
+#include <Terrain.h>
+
+TerrainChunk::TerrainChunk(Terrain* terrain, int column, int row) {
+	constexpr int SIZE = Terrain::CHUNK_SIZE;
+
+	this->terrain = terrain;
+	this->column = column;
+	this->row = row;
+
+	int firstX = column * SIZE;
+	int firstZ = row * SIZE;
+	std::shared_ptr<MeshResource> mesh = std::make_shared<MeshResource>();
+
+	for (int i = 0; i < terrain->chunkVertexCoordinates.size(); i++) {
+		const Coordinate& coordinate = terrain->chunkVertexCoordinates.at(i);
+		int x = firstX + coordinate.x;
+		int z = firstZ + coordinate.y;
+
+		mesh->addVertex(
+			{ coordinate.x * terrain->tileSize, terrain->getHeight(x, z), coordinate.y * terrain->tileSize },
+			terrain->colors.at(terrain->getVertexIndex(x, z))
+		);
+	}
+
+	setMesh(mesh);
+
+	// The error of each level is the furthest any skipped vertex lies
+	// from the coarser surface, which is interpolated across the same
+	// two triangles per cell as the finest level
+	levelErrors.resize(Terrain::LEVELS, 0.0f);
+
+	for (int level = 1; level < Terrain::LEVELS; level++) {
+		int step = 1 << level;
+		float maxError = levelErrors.at(level - 1);
+
+		for (int z = 0; z <= SIZE; z++) {
+			for (int x = 0; x <= SIZE; x++) {
+				int cellX = std::min(x / step * step, SIZE - step);
+				int cellZ = std::min(z / step * step, SIZE - step);
+				float u = (float)(x - cellX) / step;
+				float w = (float)(z - cellZ) / step;
+				float a = terrain->getHeight(firstX + cellX, firstZ + cellZ);
+				float b = terrain->getHeight(firstX + cellX + step, firstZ + cellZ);
+				float c = terrain->getHeight(firstX + cellX, firstZ + cellZ + step);
+				float d = terrain->getHeight(firstX + cellX + step, firstZ + cellZ + step);
+				float interpolated = u + w <= 1 ? a + u * (b - a) + w * (c - a) : d + (1 - u) * (c - d) + (1 - w) * (b - d);
+
+				maxError = std::max(maxError, std::abs(terrain->getHeight(firstX + x, firstZ + z) - interpolated));
+			}
+		}
+
+		levelErrors.at(level) = maxError;
+	}
+}
+
+Span<uint32_t> TerrainChunk::getIndices() {
+	const std::vector<uint32_t>& levelIndices = terrain->levelIndices.at(level * 16 + stitchMask);
+
+	return { levelIndices.data(), (int)levelIndices.size() };
+}
+
+int TerrainChunk::getLevel() {
+	return level;
+}
+
+int TerrainChunk::getVertexCount() {
+	return terrain->levelVertexCounts.at(level);
+}
+
+/**
+ * Creates a terrain of the given number of tiles, rounded up to a
+ * whole number of chunks, with random heights and colors.
+ */
+Terrain::Terrain(int rows, int columns, float tileSize) {
+	this->tileSize = tileSize;
+
+	chunkRows = std::max((rows + CHUNK_SIZE - 1) / CHUNK_SIZE, 1);
+	chunkColumns = std::max((columns + CHUNK_SIZE - 1) / CHUNK_SIZE, 1);
+
+	int verticesPerRow = chunkColumns * CHUNK_SIZE + 1;
+	int verticesPerColumn = chunkRows * CHUNK_SIZE + 1;
+
+	for (int i = 0; i < verticesPerRow * verticesPerColumn; i++) {
+		heights.push_back((float)Random::nextInt(50));
+		colors.push_back({ Random::nextInt(255), Random::nextInt(255), Random::nextInt(255) });
+	}
+
+	createChunkLayout();
+
+	for (int row = 0; row < chunkRows; row++) {
+		for (int column = 0; column < chunkColumns; column++) {
+			chunks.push_back(new TerrainChunk(this, column, row));
+		}
+	}
+
+	selectedLevels.resize(chunks.size());
+
+	setPosition({ 0, 0, 0 });
+}
+
+Terrain::~Terrain() {
+	for (int i = 0; i < chunks.size(); i++) {
+		delete chunks.at(i);
+	}
+
+	chunks.clear();
+}
+
+/**
+ * Creates the index set for a level of detail, with the edges in
+ * the stitch mask stitched to a neighbor at the next coarser level.
+ * Stitched edges collapse every other vertex onto the one before it,
+ * and drop the polygons which become degenerate as a result.
+ */
+void Terrain::createChunkIndices(int level, int stitchMask) {
+	std::vector<uint32_t>& indices = levelIndices.at(level * 16 + stitchMask);
+	int step = 1 << level;
+
+	auto getStitchedIndex = [&](int x, int z) {
+		bool isOddX = (x / step) % 2 == 1;
+		bool isOddZ = (z / step) % 2 == 1;
+
+		if (isOddX && ((z == 0 && stitchMask & STITCH_TOP) || (z == CHUNK_SIZE && stitchMask & STITCH_BOTTOM))) {
+			x -= step;
+		} else if (isOddZ && ((x == 0 && stitchMask & STITCH_LEFT) || (x == CHUNK_SIZE && stitchMask & STITCH_RIGHT))) {
+			z -= step;
+		}
+
+		return chunkVertexIndices.at(z * (CHUNK_SIZE + 1) + x);
+	};
+
+	auto addPolygon = [&](uint32_t v1, uint32_t v2, uint32_t v3) {
+		if (v1 != v2 && v2 != v3 && v3 != v1) {
+			indices.push_back(v1);
+			indices.push_back(v2);
+			indices.push_back(v3);
+		}
+	};
+
+	// Polygons are split and wound the same way as Mesh's
+	for (int z = 0; z < CHUNK_SIZE; z += step) {
+		for (int x = 0; x < CHUNK_SIZE; x += step) {
+			uint32_t topLeft = getStitchedIndex(x, z);
+			uint32_t topRight = getStitchedIndex(x + step, z);
+			uint32_t bottomLeft = getStitchedIndex(x, z + step);
+			uint32_t bottomRight = getStitchedIndex(x + step, z + step);
+
+			addPolygon(topLeft, bottomLeft, topRight);
+			addPolygon(topRight, bottomLeft, bottomRight);
+		}
+	}
+}
+
+/**
+ * Determines the vertex order and index sets shared by every chunk.
+ * Vertices are sorted by the coarsest level including them, so that
+ * each level's vertices are a prefix of the next finer level's.
+ */
+void Terrain::createChunkLayout() {
+	int verticesPerRow = CHUNK_SIZE + 1;
+
+	for (int z = 0; z < verticesPerRow; z++) {
+		for (int x = 0; x < verticesPerRow; x++) {
+			chunkVertexCoordinates.push_back({ x, z });
+		}
+	}
+
+	auto getCoarsestLevel = [](const Coordinate& coordinate) {
+		int level = 0;
+
+		while (level < LEVELS - 1 && coordinate.x % (2 << level) == 0 && coordinate.y % (2 << level) == 0) {
+			level++;
+		}
+
+		return level;
+	};
+
+	std::stable_sort(chunkVertexCoordinates.begin(), chunkVertexCoordinates.end(), [&](const Coordinate& a, const Coordinate& b) {
+		return getCoarsestLevel(a) > getCoarsestLevel(b);
+	});
+
+	chunkVertexIndices.resize(verticesPerRow * verticesPerRow);
+	levelVertexCounts.resize(LEVELS, 0);
+
+	for (int i = 0; i < chunkVertexCoordinates.size(); i++) {
+		const Coordinate& coordinate = chunkVertexCoordinates.at(i);
+
+		chunkVertexIndices.at(coordinate.y * verticesPerRow + coordinate.x) = i;
+
+		for (int level = 0; level <= getCoarsestLevel(coordinate); level++) {
+			levelVertexCounts.at(level)++;
+		}
+	}
+
+	levelIndices.resize(LEVELS * 16);
+
+	for (int level = 0; level < LEVELS; level++) {
+		for (int stitchMask = 0; stitchMask < 16; stitchMask++) {
+			createChunkIndices(level, stitchMask);
+		}
+	}
+}
+
+const std::vector<TerrainChunk*>& Terrain::getChunks() {
+	return chunks;
+}
+
+float Terrain::getHeight(int x, int z) {
+	return heights.at(getVertexIndex(x, z));
+}
+
+/**
+ * Returns the index of the terrain-wide vertex at (x, z) into its
+ * heights and colors.
+ */
+int Terrain::getVertexIndex(int x, int z) {
+	return z * (chunkColumns * CHUNK_SIZE + 1) + x;
+}
+
+/**
+ * Selects the level of detail of every chunk for a camera, given the
+ * focal length, in pixels, at which it projects onto the screen.
+ */
+void Terrain::selectLevels(const Vec3& cameraPosition, float focalLength) {
+	for (int i = 0; i < chunks.size(); i++) {
+		TerrainChunk* chunk = chunks.at(i);
+		const BoundingBox& bounds = chunk->getWorldBounds();
+		const Vec3& min = bounds.min;
+		const Vec3& max = bounds.max;
+
+		Vec3 offset = {
+			std::max({ min.x - cameraPosition.x, cameraPosition.x - max.x, 0.0f }),
+			std::max({ min.y - cameraPosition.y, cameraPosition.y - max.y, 0.0f }),
+			std::max({ min.z - cameraPosition.z, cameraPosition.z - max.z, 0.0f })
+		};
+
+		// Near the screen center, a unit offset at a distance d spans
+		// focalLength / d pixels
+		float pixelsPerUnit = focalLength / std::max(offset.magnitude(), 1.0f);
+		int level = 0;
+
+		for (int l = LEVELS - 1; l > 0; l--) {
+			if (chunk->levelErrors.at(l) * pixelsPerUnit <= maxScreenError) {
+				level = l;
+				break;
+			}
+		}
+
+		selectedLevels.at(i) = level;
+	}
+
+	// Column and row offsets of each neighbor, with the edge shared
+	// with it
+	constexpr int NEIGHBORS[4][3] = {
+		{ 0, -1, STITCH_TOP },
+		{ 1, 0, STITCH_RIGHT },
+		{ 0, 1, STITCH_BOTTOM },
+		{ -1, 0, STITCH_LEFT }
+	};
+
+	auto getNeighborLevel = [&](int column, int row, int neighbor) {
+		int neighborColumn = column + NEIGHBORS[neighbor][0];
+		int neighborRow = row + NEIGHBORS[neighbor][1];
+		bool isInside = neighborColumn >= 0 && neighborColumn < chunkColumns && neighborRow >= 0 && neighborRow < chunkRows;
+
+		return isInside ? selectedLevels.at(neighborRow * chunkColumns + neighborColumn) : -1;
+	};
+
+	// Refine chunks until no two neighbors are more than one level
+	// apart, since stitching only bridges a single level
+	bool hasChanged = true;
+
+	while (hasChanged) {
+		hasChanged = false;
+
+		for (int row = 0; row < chunkRows; row++) {
+			for (int column = 0; column < chunkColumns; column++) {
+				int& level = selectedLevels.at(row * chunkColumns + column);
+
+				for (int n = 0; n < 4; n++) {
+					int neighborLevel = getNeighborLevel(column, row, n);
+
+					if (neighborLevel >= 0 && level > neighborLevel + 1) {
+						level = neighborLevel + 1;
+						hasChanged = true;
+					}
+				}
+			}
+		}
+	}
+
+	for (int row = 0; row < chunkRows; row++) {
+		for (int column = 0; column < chunkColumns; column++) {
+			TerrainChunk* chunk = chunks.at(row * chunkColumns + column);
+
+			chunk->level = selectedLevels.at(row * chunkColumns + column);
+			chunk->stitchMask = 0;
+
+			for (int n = 0; n < 4; n++) {
+				if (getNeighborLevel(column, row, n) > chunk->level) {
+					chunk->stitchMask |= NEIGHBORS[n][2];
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Sets the largest height error, in pixels, which a chunk's level
+ * of detail may introduce on screen.
+ */
+void Terrain::setMaxScreenError(float maxScreenError) {
+	this->maxScreenError = maxScreenError;
+}
+
+void Terrain::setPosition(const Vec3& position) {
+	for (int i = 0; i < chunks.size(); i++) {
+		TerrainChunk* chunk = chunks.at(i);
+
+		chunk->setPosition(position + Vec3(chunk->column * CHUNK_SIZE * tileSize, 0, chunk->row * CHUNK_SIZE * tileSize));
+	}
+}
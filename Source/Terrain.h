@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <Objects.h>
+#include <Types.h>
+
+class Terrain;
+
+/**
+ * A square section of a terrain's height field, drawn at the level of
+ * detail its terrain selects for it. Its vertices are ordered from the
+ * coarsest level to the finest, so each level only transforms a prefix
+ * of them.
+ */
+struct TerrainChunk : Object {
+	public:
+		TerrainChunk(Terrain* terrain, int column, int row);
+
+		Span<uint32_t> getIndices() override;
+		int getLevel();
+		int getVertexCount() override;
+
+	private:
+		friend class Terrain;
+
+		Terrain* terrain;
+		int column;
+		int row;
+		int level = 0;
+		int stitchMask = 0;
+		std::vector<float> levelErrors;
+};
+
+/**
+ * A grid-based height field, like Mesh, split into chunks of CHUNK_SIZE
+ * x CHUNK_SIZE tiles with LEVELS levels of detail. Level n spans 2^n
+ * tiles per polygon pair. Each frame, every chunk is drawn at the
+ * coarsest level whose height error projects to no more than the
+ * maximum screen-space error, and neighboring chunks are kept within
+ * one level of each other. Edges shared with a coarser neighbor are
+ * stitched by collapsing the vertices which the neighbor lacks, so
+ * that no cracks open up between them.
+ */
+class Terrain {
+	public:
+		constexpr static int CHUNK_SIZE = 16;
+		constexpr static int LEVELS = 5;
+
+		Terrain(int rows, int columns, float tileSize);
+		~Terrain();
+		const std::vector<TerrainChunk*>& getChunks();
+		void selectLevels(const Vec3& cameraPosition, float focalLength);
+		void setMaxScreenError(float maxScreenError);
+		void setPosition(const Vec3& position);
+	private:
+		friend struct TerrainChunk;
+
+		// Bits of a chunk's stitch mask, set for each edge shared
+		// with a neighboring chunk at the next coarser level
+		enum StitchEdge {
+			STITCH_TOP = 1 << 0,
+			STITCH_RIGHT = 1 << 1,
+			STITCH_BOTTOM = 1 << 2,
+			STITCH_LEFT = 1 << 3
+		};
+
+		std::vector<TerrainChunk*> chunks;
+		std::vector<float> heights;
+		std::vector<Color> colors;
+		std::vector<int> levelVertexCounts;
+		std::vector<Coordinate> chunkVertexCoordinates;
+		std::vector<uint32_t> chunkVertexIndices;
+		std::vector<std::vector<uint32_t>> levelIndices;
+		std::vector<int> selectedLevels;
+		int chunkRows;
+		int chunkColumns;
+		float tileSize;
+		float maxScreenError = 4.0f;
+		void createChunkIndices(int level, int stitchMask);
+		void createChunkLayout();
+		float getHeight(int x, int z);
+		int getVertexIndex(int x, int z);
+};
@@ -0,0 +1,267 @@
+#include <stdio.h>
+#include <algorithm>
+#include <Texture.h>
+
+namespace {
+	bool isPowerOfTwo(int value) {
+		return value > 0 && (value & (value - 1)) == 0;
+	}
+
+	bool isValidSize(int width, int height) {
+		return (
+			isPowerOfTwo(width) && width <= Texture::MAX_SIZE &&
+			isPowerOfTwo(height) && height <= Texture::MAX_SIZE
+		);
+	}
+
+	int getLog2(int powerOfTwo) {
+		int bits = 0;
+
+		while ((1 << bits) < powerOfTwo) {
+			bits++;
+		}
+
+		return bits;
+	}
+
+	/**
+	 * Spreads the bits of a value out to every other bit, e.g.
+	 * 0b111 to 0b10101.
+	 */
+	Uint32 spreadBits(Uint32 value) {
+		value &= 0xFFFF;
+		value = (value | (value << 8)) & 0x00FF00FF;
+		value = (value | (value << 4)) & 0x0F0F0F0F;
+		value = (value | (value << 2)) & 0x33333333;
+		value = (value | (value << 1)) & 0x55555555;
+
+		return value;
+	}
+
+	/**
+	 * Halves an image in each dimension of more than one pixel,
+	 * averaging every 2x2 block of pixels.
+	 */
+	std::vector<Uint32> downsample(int width, int height, const std::vector<Uint32>& pixels) {
+		int halfWidth = std::max(width / 2, 1);
+		int halfHeight = std::max(height / 2, 1);
+		std::vector<Uint32> halved(halfWidth * halfHeight);
+
+		for (int y = 0; y < halfHeight; y++) {
+			for (int x = 0; x < halfWidth; x++) {
+				int x1 = std::min(x * 2, width - 1);
+				int x2 = std::min(x * 2 + 1, width - 1);
+				int y1 = std::min(y * 2, height - 1);
+				int y2 = std::min(y * 2 + 1, height - 1);
+				const Uint32 block[4] = { pixels[y1 * width + x1], pixels[y1 * width + x2], pixels[y2 * width + x1], pixels[y2 * width + x2] };
+				Uint32 average = 0;
+
+				for (int shift = 0; shift < 32; shift += 8) {
+					Uint32 sum = 2;
+
+					for (Uint32 pixel : block) {
+						sum += (pixel >> shift) & 0xFF;
+					}
+
+					average |= (sum / 4) << shift;
+				}
+
+				halved[y * halfWidth + x] = average;
+			}
+		}
+
+		return halved;
+	}
+
+	/**
+	 * Reads the next whitespace-separated number from a PPM header,
+	 * skipping comments.
+	 */
+	bool readHeaderValue(FILE* file, int* value) {
+		int c = fgetc(file);
+
+		while (c == '#' || c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+			if (c == '#') {
+				while (c != '\n' && c != EOF) {
+					c = fgetc(file);
+				}
+			}
+
+			c = fgetc(file);
+		}
+
+		ungetc(c, file);
+
+		return fscanf(file, "%d", value) == 1;
+	}
+}
+
+/**
+ * Creates a texture from row-major pixels, in the same format as the
+ * rasterizer's pixels, and generates its mip levels. Returns NULL
+ * unless its width and height are powers of two, up to MAX_SIZE.
+ */
+std::shared_ptr<const Texture> Texture::create(int width, int height, const Uint32* pixels) {
+	if (!isValidSize(width, height)) {
+		return NULL;
+	}
+
+	std::shared_ptr<Texture> texture(new Texture());
+	int totalTexels = 0;
+	int totalOffsets = 0;
+
+	for (int w = width, h = height; ; w = std::max(w / 2, 1), h = std::max(h / 2, 1)) {
+		totalTexels += w * h;
+		totalOffsets += w + h;
+
+		if (w == 1 && h == 1) {
+			break;
+		}
+	}
+
+	// Levels point into the texture's arrays, so they're allocated
+	// up front, and never move as levels are added
+	texture->texels.reserve(totalTexels);
+	texture->offsets.reserve(totalOffsets);
+
+	std::vector<Uint32> level(pixels, pixels + width * height);
+
+	while (true) {
+		texture->addLevel(width, height, level);
+
+		if (width == 1 && height == 1) {
+			break;
+		}
+
+		level = downsample(width, height, level);
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+	}
+
+	return texture;
+}
+
+/**
+ * Creates a square texture of size x size texels, checkered with
+ * squares x squares squares of alternating colors.
+ */
+std::shared_ptr<const Texture> Texture::createCheckerboard(int size, int squares, const Color& first, const Color& second) {
+	std::vector<Uint32> pixels(size * size);
+	int squareSize = std::max(size / squares, 1);
+
+	for (int y = 0; y < size; y++) {
+		for (int x = 0; x < size; x++) {
+			const Color& color = (x / squareSize + y / squareSize) % 2 == 0 ? first : second;
+
+			pixels[y * size + x] = color.value;
+		}
+	}
+
+	return create(size, size, pixels.data());
+}
+
+/**
+ * Loads a texture from a binary (P6) PPM, as saved by
+ * FramebufferTarget::savePPM(). Returns NULL if the file can't be
+ * read, or its dimensions aren't powers of two up to MAX_SIZE.
+ */
+std::shared_ptr<const Texture> Texture::load(const char* path) {
+	FILE* file = fopen(path, "rb");
+
+	if (file == NULL) {
+		return NULL;
+	}
+
+	char magic[2] = { };
+	int width = 0;
+	int height = 0;
+	int maxValue = 0;
+
+	bool isValid = (
+		fread(magic, 1, 2, file) == 2 && magic[0] == 'P' && magic[1] == '6' &&
+		readHeaderValue(file, &width) &&
+		readHeaderValue(file, &height) &&
+		readHeaderValue(file, &maxValue) &&
+		maxValue > 0 && maxValue < 256 &&
+		isValidSize(width, height) &&
+		fgetc(file) != EOF
+	);
+
+	// At MAX_SIZE, three bytes per pixel no longer fit in an int
+	std::vector<Uint8> rgb(isValid ? (size_t)width * height * 3 : 0);
+
+	isValid = isValid && fread(rgb.data(), 1, rgb.size(), file) == rgb.size();
+
+	fclose(file);
+
+	if (!isValid) {
+		return NULL;
+	}
+
+	std::vector<Uint32> pixels(width * height);
+
+	for (size_t i = 0; i < pixels.size(); i++) {
+		Uint32 R = rgb[i * 3] * 255 / maxValue;
+		Uint32 G = rgb[i * 3 + 1] * 255 / maxValue;
+		Uint32 B = rgb[i * 3 + 2] * 255 / maxValue;
+
+		pixels[i] = (255 << 24) | (R << 16) | (G << 8) | B;
+	}
+
+	return create(width, height, pixels.data());
+}
+
+int Texture::getHeight() const {
+	return levels.front().height;
+}
+
+const TextureLevel& Texture::getLevel(int level) const {
+	return levels[level];
+}
+
+int Texture::getLevelCount() const {
+	return levels.size();
+}
+
+int Texture::getWidth() const {
+	return levels.front().width;
+}
+
+/**
+ * Appends a mip level, reordering its row-major pixels into Morton
+ * order. Rectangular levels are stored as a row or column of square
+ * Morton ordered blocks, whose index makes up the topmost bits of
+ * the longer axis' offsets.
+ */
+void Texture::addLevel(int width, int height, const std::vector<Uint32>& pixels) {
+	int blockBits = getLog2(std::min(width, height));
+	Uint32 blockMask = (1 << blockBits) - 1;
+	TextureLevel level;
+
+	level.width = width;
+	level.height = height;
+	level.texels = texels.data() + texels.size();
+	level.columnOffsets = offsets.data() + offsets.size();
+
+	for (int x = 0; x < width; x++) {
+		offsets.push_back(spreadBits(x & blockMask) | ((x >> blockBits) << (2 * blockBits)));
+	}
+
+	level.rowOffsets = offsets.data() + offsets.size();
+
+	for (int y = 0; y < height; y++) {
+		offsets.push_back((spreadBits(y & blockMask) << 1) | ((y >> blockBits) << (2 * blockBits)));
+	}
+
+	texels.resize(texels.size() + width * height);
+
+	Uint32* levelTexels = texels.data() + (texels.size() - width * height);
+
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			levelTexels[level.columnOffsets[x] | level.rowOffsets[y]] = pixels[y * width + x];
+		}
+	}
+
+	levels.push_back(level);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <SDL.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <Types.h>
+
+/**
+ * A single mip level of a texture. Texels are stored in Morton (Z)
+ * order, interleaving the bits of their x and y coordinates, so that
+ * texels near each other on either axis are near each other in memory,
+ * and fetches stay within a few cache lines however a surface is
+ * rotated on screen. Each column and row's share of a texel's index is
+ * looked up from a table, and the two combined with a single OR.
+ */
+struct TextureLevel {
+	const Uint32* texels;
+	const Uint32* columnOffsets;
+	const Uint32* rowOffsets;
+	int width;
+	int height;
+
+	/**
+	 * Returns the texel nearest to texture coordinates (u, v), which
+	 * repeat outside of the range 0 to 1.
+	 */
+	Uint32 sample(float u, float v) const {
+		int x = toTexel(u * width) & (width - 1);
+		int y = toTexel(v * height) & (height - 1);
+
+		return texels[columnOffsets[x] | rowOffsets[y]];
+	}
+
+	/**
+	 * Rounds towards negative infinity, so that texels repeat
+	 * seamlessly across zero. Texture coordinates blow up near w = 0,
+	 * beyond the range of an int, so they're clamped first, with NaNs
+	 * clamped to the lower limit.
+	 */
+	static int toTexel(float value) {
+		constexpr static float LIMIT = 1 << 30;
+
+		value = value > -LIMIT ? std::min(value, LIMIT) : -LIMIT;
+
+		int texel = (int)value;
+
+		return texel - (value < texel);
+	}
+};
+
+/**
+ * An image mapped onto triangles by their vertices' texture
+ * coordinates, along with a chain of mip levels, each half the size of
+ * the last down to a single texel. Sampling a level whose texels are
+ * about the size of a screen pixel keeps distant surfaces from
+ * aliasing, and keeps neighboring pixels' fetches close together in
+ * memory. Widths and heights must be powers of two, up to MAX_SIZE,
+ * which keeps every texel's Morton index within an int.
+ */
+class Texture {
+	public:
+		constexpr static int MAX_SIZE = 1 << 15;
+
+		static std::shared_ptr<const Texture> create(int width, int height, const Uint32* pixels);
+		static std::shared_ptr<const Texture> createCheckerboard(int size, int squares, const Color& first, const Color& second);
+		static std::shared_ptr<const Texture> load(const char* path);
+		int getHeight() const;
+		const TextureLevel& getLevel(int level) const;
+		int getLevelCount() const;
+		int getWidth() const;
+	private:
+		std::vector<Uint32> texels;
+		std::vector<Uint32> offsets;
+		std::vector<TextureLevel> levels;
+
+		Texture() = default;
+		Texture(const Texture&) = delete;
+		void addLevel(int width, int height, const std::vector<Uint32>& pixels);
+};
@@ -0,0 +1,87 @@
+#include <ThreadPool.h>
+
+ThreadPool::ThreadPool(int threadCount) {
+	nextTask = 0;
+
+	// The calling thread acts as one of the workers
+	for (int i = 1; i < threadCount; i++) {
+		workers.emplace_back(&ThreadPool::work, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		isStopping = true;
+	}
+
+	wakeCondition.notify_all();
+
+	for (int i = 0; i < workers.size(); i++) {
+		workers.at(i).join();
+	}
+}
+
+int ThreadPool::getThreadCount() {
+	return workers.size() + 1;
+}
+
+void ThreadPool::run(int taskCount, const std::function<void(int)>& task) {
+	if (workers.empty()) {
+		for (int i = 0; i < taskCount; i++) {
+			task(i);
+		}
+
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		this->task = &task;
+		this->taskCount = taskCount;
+		nextTask = 0;
+		activeWorkers = workers.size();
+		generation++;
+	}
+
+	wakeCondition.notify_all();
+	runTasks();
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	doneCondition.wait(lock, [=]() { return activeWorkers == 0; });
+}
+
+void ThreadPool::runTasks() {
+	int index;
+
+	while ((index = nextTask++) < taskCount) {
+		(*task)(index);
+	}
+}
+
+void ThreadPool::work() {
+	unsigned int lastGeneration = 0;
+
+	while (true) {
+		std::unique_lock<std::mutex> lock(mutex);
+
+		wakeCondition.wait(lock, [&]() { return isStopping || generation != lastGeneration; });
+
+		if (isStopping) {
+			return;
+		}
+
+		lastGeneration = generation;
+		lock.unlock();
+
+		runTasks();
+
+		lock.lock();
+
+		if (--activeWorkers == 0) {
+			doneCondition.notify_one();
+		}
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A fixed set of worker threads which cooperatively process batches
+ * of indexed tasks. The thread calling run() participates in the batch
+ * and only returns once every task has completed.
+ */
+class ThreadPool {
+	public:
+		ThreadPool(int threadCount);
+		~ThreadPool();
+		int getThreadCount();
+		void run(int taskCount, const std::function<void(int)>& task);
+	private:
+		std::vector<std::thread> workers;
+		std::mutex mutex;
+		std::condition_variable wakeCondition;
+		std::condition_variable doneCondition;
+		const std::function<void(int)>* task = nullptr;
+		std::atomic<int> nextTask;
+		int taskCount = 0;
+		int activeWorkers = 0;
+		unsigned int generation = 0;
+		bool isStopping = false;
+		void runTasks();
+		void work();
+};
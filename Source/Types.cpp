@@ -1,3 +1,4 @@
+#include <math.h>
 #include <memory>
 #include <Types.h>
 
@@ -9,6 +10,14 @@ RotationMatrix RotationMatrix::operator *(const RotationMatrix& rm) const {
 	};
 }
 
+RotationMatrix RotationMatrix::operator *(float scalar) const {
+	return {
+		m11 * scalar, m12 * scalar, m13 * scalar,
+		m21 * scalar, m22 * scalar, m23 * scalar,
+		m31 * scalar, m32 * scalar, m33 * scalar
+	};
+}
+
 RotationMatrix RotationMatrix::calculate(const Vec3& rotation) {
 	float sx = sin(rotation.x);
 	float sy = sin(rotation.y);
@@ -32,6 +41,65 @@ Vec3 RotationMatrix::operator *(const Vec3& v) const {
 	};
 }
 
+RotationMatrix RotationMatrix::transpose() const {
+	return {
+		m11, m21, m31,
+		m12, m22, m32,
+		m13, m23, m33
+	};
+}
+
+/**
+ * Creates a perspective projection from view space straight onto the
+ * screen. Dividing a projected point by its w, which is its view depth,
+ * yields its screen coordinates in x and y, and in z its depth as a
+ * fixed point fraction of the way from the near plane to the far
+ * plane. Since it's proportional to 1 / w, this depth varies linearly
+ * across the screen, so it can be interpolated between vertices in
+ * screen space. Points in front of the near plane have z >= 0.
+ */
+Matrix4 Matrix4::createPerspective(float focalLength, float halfWidth, float halfHeight, float nearDistance, float farDistance) {
+	float depthScale = (float)(1 << DEPTH_BITS) * farDistance / (farDistance - nearDistance);
+
+	return {
+		focalLength, 0, halfWidth, 0,
+		0, -focalLength, halfHeight, 0,
+		0, 0, depthScale, -depthScale * nearDistance,
+		0, 0, 1, 0
+	};
+}
+
+/**
+ * Creates a transform which applies a rotation matrix, then
+ * a translation.
+ */
+Matrix4 Matrix4::createTransform(const RotationMatrix& rm, const Vec3& translation) {
+	return {
+		rm.m11, rm.m12, rm.m13, translation.x,
+		rm.m21, rm.m22, rm.m23, translation.y,
+		rm.m31, rm.m32, rm.m33, translation.z,
+		0, 0, 0, 1
+	};
+}
+
+Matrix4 Matrix4::operator *(const Matrix4& m) const {
+	return {
+		m11 * m.m11 + m12 * m.m21 + m13 * m.m31 + m14 * m.m41, m11 * m.m12 + m12 * m.m22 + m13 * m.m32 + m14 * m.m42, m11 * m.m13 + m12 * m.m23 + m13 * m.m33 + m14 * m.m43, m11 * m.m14 + m12 * m.m24 + m13 * m.m34 + m14 * m.m44,
+		m21 * m.m11 + m22 * m.m21 + m23 * m.m31 + m24 * m.m41, m21 * m.m12 + m22 * m.m22 + m23 * m.m32 + m24 * m.m42, m21 * m.m13 + m22 * m.m23 + m23 * m.m33 + m24 * m.m43, m21 * m.m14 + m22 * m.m24 + m23 * m.m34 + m24 * m.m44,
+		m31 * m.m11 + m32 * m.m21 + m33 * m.m31 + m34 * m.m41, m31 * m.m12 + m32 * m.m22 + m33 * m.m32 + m34 * m.m42, m31 * m.m13 + m32 * m.m23 + m33 * m.m33 + m34 * m.m43, m31 * m.m14 + m32 * m.m24 + m33 * m.m34 + m34 * m.m44,
+		m41 * m.m11 + m42 * m.m21 + m43 * m.m31 + m44 * m.m41, m41 * m.m12 + m42 * m.m22 + m43 * m.m32 + m44 * m.m42, m41 * m.m13 + m42 * m.m23 + m43 * m.m33 + m44 * m.m43, m41 * m.m14 + m42 * m.m24 + m43 * m.m34 + m44 * m.m44
+	};
+}
+
+Vec4 Matrix4::operator *(const Vec3& v) const {
+	return {
+		m11 * v.x + m12 * v.y + m13 * v.z + m14,
+		m21 * v.x + m22 * v.y + m23 * v.z + m24,
+		m31 * v.x + m32 * v.y + m33 * v.z + m34,
+		m41 * v.x + m42 * v.y + m43 * v.z + m44
+	};
+}
+
 Vec3::Vec3() {}
 
 Vec3::Vec3(float x, float y, float z) {
@@ -78,17 +146,137 @@ Vec3 Vec3::operator -(const Vec3& vector) const {
 	};
 }
 
-void Triangle::createVertex(int index, int x, int y, int depth, const Color& color) {
-	Vertex2d vertex;
+Vec3 Vec3::operator *(float scalar) const {
+	return {
+		x * scalar,
+		y * scalar,
+		z * scalar
+	};
+}
+
+Vec4 Vec4::operator +(const Vec4& vector) const {
+	return { x + vector.x, y + vector.y, z + vector.z, w + vector.w };
+}
+
+Vec4 Vec4::operator -(const Vec4& vector) const {
+	return { x - vector.x, y - vector.y, z - vector.z, w - vector.w };
+}
 
-	vertex.coordinate.x = x;
-	vertex.coordinate.y = y;
-	vertex.depth = depth;
-	vertex.color = color;
+Vec4 Vec4::operator *(float scalar) const {
+	return { x * scalar, y * scalar, z * scalar, w * scalar };
+}
+
+Vec3 BoundingBox::getCenter() const {
+	return (min + max) * 0.5f;
+}
+
+/**
+ * Returns the radius of the box's bounding sphere.
+ */
+float BoundingBox::getRadius() const {
+	return ((max - min) * 0.5f).magnitude();
+}
+
+float Plane::distanceTo(const Vec3& point) const {
+	return normal.x * point.x + normal.y * point.y + normal.z * point.z + distance;
+}
+
+/**
+ * Determines whether any part of a sphere might lie within the
+ * frustum. Spheres are only rejected if they lie entirely behind
+ * one of its planes.
+ */
+bool Frustum::intersectsSphere(const Vec3& center, float radius) const {
+	for (int i = 0; i < 6; i++) {
+		if (planes[i].distanceTo(center) < -radius) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Converts a view-space frustum into world space, given the view's
+ * rotation and position. View-space points are v = R * (w - p), so a
+ * plane n . v + d = 0 becomes (R^T * n) . w + d - (R^T * n) . p = 0.
+ */
+Frustum Frustum::toWorldSpace(const RotationMatrix& viewRotation, const Vec3& viewPosition) const {
+	RotationMatrix inverseRotation = viewRotation.transpose();
+	Frustum frustum;
+
+	for (int i = 0; i < 6; i++) {
+		Vec3 normal = inverseRotation * planes[i].normal;
+
+		frustum.planes[i].normal = normal;
+		frustum.planes[i].distance = planes[i].distance - (normal.x * viewPosition.x + normal.y * viewPosition.y + normal.z * viewPosition.z);
+	}
+
+	return frustum;
+}
+
+/**
+ * Converts a screen coordinate to sub-pixel fixed point, clamping
+ * it to a range which is safe for the half-space rasterizer.
+ */
+static int toSubpixel(float value) {
+	float scaled = value * (1 << SUBPIXEL_BITS);
+
+	if (!(scaled > -SUBPIXEL_LIMIT)) {
+		return -SUBPIXEL_LIMIT;
+	} else if (scaled > SUBPIXEL_LIMIT) {
+		return SUBPIXEL_LIMIT;
+	}
+
+	return (int)lroundf(scaled);
+}
+
+/**
+ * Truncates a screen coordinate to a whole pixel, clamping it to the
+ * same range as toSubpixel(). Vertices behind the camera project to
+ * infinite or NaN coordinates, which can't be cast to int.
+ */
+static int toPixel(float value) {
+	constexpr static float LIMIT = SUBPIXEL_LIMIT >> SUBPIXEL_BITS;
+
+	if (!(value > -LIMIT)) {
+		return -LIMIT;
+	} else if (value > LIMIT) {
+		return LIMIT;
+	}
+
+	return (int)value;
+}
+
+void Vertex2d::set(float x, float y, int depth, const Color& color) {
+	coordinate.x = toPixel(x);
+	coordinate.y = toPixel(y);
+	subpixel.x = toSubpixel(x);
+	subpixel.y = toSubpixel(y);
+	this->depth = depth;
+	this->color = color;
+}
+
+void Triangle::createVertex(int index, float x, float y, int depth, const Color& color) {
+	vertices[index].set(x, y, depth, color);
+}
+
+VertexSpan VertexStream::getSpan() const {
+	return { x.data(), y.data(), z.data(), size() };
+}
+
+void VertexStream::push(const Vec3& vector) {
+	x.push_back(vector.x);
+	y.push_back(vector.y);
+	z.push_back(vector.z);
+}
 
-	vertices[index] = vertex;
+void VertexStream::resize(int size) {
+	x.resize(size);
+	y.resize(size);
+	z.resize(size);
 }
 
-void Polygon::bindVertex(int index, Vertex3d* vertex) {
-	vertices[index] = vertex;
+int VertexStream::size() const {
+	return x.size();
 }
@@ -1,28 +1,73 @@
 #pragma once
 
+#include <stdint.h>
 #include <memory>
 #include <algorithm>
+#include <vector>
 
 struct RotationMatrix;
+class Texture;
 
+// Sub-pixel vertex coordinates are stored in fixed point with this
+// many fractional bits, and clamped to +/- SUBPIXEL_LIMIT
+constexpr static int SUBPIXEL_BITS = 4;
+constexpr static int SUBPIXEL_LIMIT = 1 << 24;
+
+// Depths are stored in fixed point with this many bits, spanning
+// the distance from the near plane to the far plane (see
+// Matrix4::createPerspective())
+constexpr static int DEPTH_BITS = 24;
+
+/**
+ * An 8 bit per channel RGBA color, packed into 32 bits in the same
+ * order as the rasterizer's ARGB8888 pixels, so that flat shaded
+ * pixels are written as is. Channels are read and written through
+ * the accessors, and range from 0 to 255.
+ */
 struct Color {
-	int R = 255;
-	int G = 255;
-	int B = 255;
+	uint32_t value = 0xFFFFFFFF;
+
+	Color() = default;
+
+	Color(int R, int G, int B, int A = 255) {
+		value = ((uint32_t)A << 24) | ((uint32_t)R << 16) | ((uint32_t)G << 8) | (uint32_t)B;
+	}
+
+	int getR() const {
+		return (value >> 16) & 0xFF;
+	}
+
+	int getG() const {
+		return (value >> 8) & 0xFF;
+	}
+
+	int getB() const {
+		return value & 0xFF;
+	}
+
+	int getA() const {
+		return value >> 24;
+	}
+
+	bool operator ==(const Color& color) const {
+		return value == color.value;
+	}
 
 	Color operator +(int attenuation) const {
 		return {
-			std::min(R + attenuation, 255),
-			std::min(G + attenuation, 255),
-			std::min(B + attenuation, 255)
+			std::min(getR() + attenuation, 255),
+			std::min(getG() + attenuation, 255),
+			std::min(getB() + attenuation, 255),
+			getA()
 		};
 	}
 
 	Color operator -(int attenuation) const {
 		return {
-			std::max(R - attenuation, 0),
-			std::max(G - attenuation, 0),
-			std::max(B - attenuation, 0)
+			std::max(getR() - attenuation, 0),
+			std::max(getG() - attenuation, 0),
+			std::max(getB() - attenuation, 0),
+			getA()
 		};
 	}
 };
@@ -36,6 +81,15 @@ struct Coordinate {
 	int y = 0;
 };
 
+/**
+ * A position within a texture, spanning it from 0 to 1 on either
+ * axis, from the top left corner.
+ */
+struct TextureCoordinate {
+	float u = 0.0f;
+	float v = 0.0f;
+};
+
 struct Vec3 {
 	float x = 0.0f;
 	float y = 0.0f;
@@ -47,31 +101,133 @@ struct Vec3 {
 	void rotate(const RotationMatrix& rotationMatrix);
 	Vec3 operator +(const Vec3& vector) const;
 	Vec3 operator -(const Vec3& vector) const;
+	Vec3 operator *(float scalar) const;
+};
+
+struct Vec4 {
+	float x = 0.0f;
+	float y = 0.0f;
+	float z = 0.0f;
+	float w = 0.0f;
+	Vec4 operator +(const Vec4& vector) const;
+	Vec4 operator -(const Vec4& vector) const;
+	Vec4 operator *(float scalar) const;
+};
+
+struct BoundingBox {
+	Vec3 min;
+	Vec3 max;
+	Vec3 getCenter() const;
+	float getRadius() const;
+};
+
+struct Plane {
+	Vec3 normal;
+	float distance = 0.0f;
+	float distanceTo(const Vec3& point) const;
+};
+
+/**
+ * A convex viewing volume, bounded by six inward-facing planes.
+ */
+struct Frustum {
+	Plane planes[6];
+	bool intersectsSphere(const Vec3& center, float radius) const;
+	Frustum toWorldSpace(const RotationMatrix& viewRotation, const Vec3& viewPosition) const;
 };
 
 struct RotationMatrix {
 	float m11, m12, m13, m21, m22, m23, m31, m32, m33;
 	static RotationMatrix calculate(const Vec3& rotation);
 	RotationMatrix operator *(const RotationMatrix& rotationMatrix) const;
+	RotationMatrix operator *(float scalar) const;
 	Vec3 operator *(const Vec3& vector) const;
+	RotationMatrix transpose() const;
 };
 
+/**
+ * A homogeneous transform, applied to points as column vectors with
+ * an implicit w of 1.
+ */
+struct Matrix4 {
+	float m11, m12, m13, m14, m21, m22, m23, m24, m31, m32, m33, m34, m41, m42, m43, m44;
+	static Matrix4 createPerspective(float focalLength, float halfWidth, float halfHeight, float nearDistance, float farDistance);
+	static Matrix4 createTransform(const RotationMatrix& rotationMatrix, const Vec3& translation);
+	Matrix4 operator *(const Matrix4& matrix) const;
+	Vec4 operator *(const Vec3& vector) const;
+};
+
+/**
+ * A projected vertex. Textured vertices also carry their texture
+ * coordinate, and the reciprocal of their clip-space w, which
+ * texture coordinates are divided by to interpolate them with
+ * perspective.
+ */
 struct Vertex2d : Colorable {
 	Coordinate coordinate;
+	Coordinate subpixel;
 	int depth;
+	TextureCoordinate uv;
+	float inverseW = 1.0f;
+	void set(float x, float y, int depth, const Color& color);
 };
 
-struct Vertex3d : Colorable {
-	Vec3 vector;
-};
-
+/**
+ * A projected triangle, textured unless its texture is NULL.
+ */
 struct Triangle {
 	Vertex2d vertices[3];
-	void createVertex(int index, int x, int y, int depth, const Color& color);
+	const Texture* texture = nullptr;
+	void createVertex(int index, float x, float y, int depth, const Color& color);
 };
 
-struct Polygon {
-	Vertex3d* vertices[3];
-	void bindVertex(int index, Vertex3d* vertex);
+/**
+ * A read-only view over structure-of-arrays vertex positions, e.g. a
+ * VertexStream's, or positions mapped from a mesh file.
+ */
+struct VertexSpan {
+	const float* x = nullptr;
+	const float* y = nullptr;
+	const float* z = nullptr;
+	int size = 0;
+};
+
+/**
+ * A structure-of-arrays stream of vertex positions. Streams output by
+ * projection also hold the reciprocal of each vertex's clip-space w,
+ * which is left empty in streams of positions.
+ */
+struct VertexStream {
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> z;
+	std::vector<float> inverseW;
+
+	VertexSpan getSpan() const;
+	void push(const Vec3& vector);
+	void resize(int size);
+	int size() const;
+};
+
+/**
+ * A read-only view over a contiguous array, e.g. an object's colors
+ * or its index buffer, for iterating without copies or callbacks.
+ */
+template<typename T>
+struct Span {
+	const T* data = nullptr;
+	int size = 0;
+
+	const T* begin() const {
+		return data;
+	}
+
+	const T* end() const {
+		return data + size;
+	}
+
+	const T& operator [](int index) const {
+		return data[index];
+	}
 };
 
@@ -0,0 +1,218 @@
+#include <math.h>
+#include <VertexProcessor.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define HAS_X86_KERNELS
+	#include <immintrin.h>
+#endif
+
+namespace {
+	/**
+	 * Projects vertices one at a time, serving as the reference
+	 * implementation for the SIMD kernels.
+	 */
+	void projectScalar(const ProjectionParameters& p, const float* inX, const float* inY, const float* inZ, float* outX, float* outY, float* outZ, float* outInverseW, int count) {
+		for (int i = 0; i < count; i++) {
+			Vec4 clipVertex = p.transform * Vec3(inX[i], inY[i], inZ[i]);
+			Vec3 vertex = VertexProcessor::divide(clipVertex);
+			bool isInView = (
+				clipVertex.z >= 0 &&
+				vertex.x >= -GUARD_BAND && vertex.x <= GUARD_BAND &&
+				vertex.y >= -GUARD_BAND && vertex.y <= GUARD_BAND
+			);
+
+			outX[i] = vertex.x;
+			outY[i] = vertex.y;
+			outZ[i] = isInView ? vertex.z : -1.0f;
+			outInverseW[i] = 1.0f / clipVertex.w;
+		}
+	}
+
+	#ifdef HAS_X86_KERNELS
+	__attribute__((target("sse2")))
+	inline void projectSSE4(const ProjectionParameters& p, const float* inX, const float* inY, const float* inZ, float* outX, float* outY, float* outZ, float* outInverseW) {
+		const Matrix4& m = p.transform;
+		__m128 x = _mm_loadu_ps(inX);
+		__m128 y = _mm_loadu_ps(inY);
+		__m128 z = _mm_loadu_ps(inZ);
+
+		__m128 cx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m.m11), x), _mm_mul_ps(_mm_set1_ps(m.m12), y)), _mm_mul_ps(_mm_set1_ps(m.m13), z)), _mm_set1_ps(m.m14));
+		__m128 cy = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m.m21), x), _mm_mul_ps(_mm_set1_ps(m.m22), y)), _mm_mul_ps(_mm_set1_ps(m.m23), z)), _mm_set1_ps(m.m24));
+		__m128 cz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m.m31), x), _mm_mul_ps(_mm_set1_ps(m.m32), y)), _mm_mul_ps(_mm_set1_ps(m.m33), z)), _mm_set1_ps(m.m34));
+		__m128 cw = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m.m41), x), _mm_mul_ps(_mm_set1_ps(m.m42), y)), _mm_mul_ps(_mm_set1_ps(m.m43), z)), _mm_set1_ps(m.m44));
+
+		__m128 inverseW = _mm_div_ps(_mm_set1_ps(1.0f), cw);
+		__m128 sx = _mm_mul_ps(cx, inverseW);
+		__m128 sy = _mm_mul_ps(cy, inverseW);
+		__m128 depth = _mm_mul_ps(cz, inverseW);
+
+		__m128 guardBand = _mm_set1_ps(GUARD_BAND);
+		__m128 negativeGuardBand = _mm_set1_ps(-GUARD_BAND);
+		__m128 isInView = _mm_and_ps(
+			_mm_and_ps(_mm_cmpge_ps(cz, _mm_setzero_ps()), _mm_and_ps(_mm_cmpge_ps(sx, negativeGuardBand), _mm_cmple_ps(sx, guardBand))),
+			_mm_and_ps(_mm_cmpge_ps(sy, negativeGuardBand), _mm_cmple_ps(sy, guardBand))
+		);
+
+		depth = _mm_or_ps(_mm_and_ps(isInView, depth), _mm_andnot_ps(isInView, _mm_set1_ps(-1.0f)));
+
+		_mm_storeu_ps(outX, sx);
+		_mm_storeu_ps(outY, sy);
+		_mm_storeu_ps(outZ, depth);
+		_mm_storeu_ps(outInverseW, inverseW);
+	}
+
+	__attribute__((target("avx2")))
+	inline void projectAVX8(const ProjectionParameters& p, const float* inX, const float* inY, const float* inZ, float* outX, float* outY, float* outZ, float* outInverseW) {
+		const Matrix4& m = p.transform;
+		__m256 x = _mm256_loadu_ps(inX);
+		__m256 y = _mm256_loadu_ps(inY);
+		__m256 z = _mm256_loadu_ps(inZ);
+
+		__m256 cx = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m.m11), x), _mm256_mul_ps(_mm256_set1_ps(m.m12), y)), _mm256_mul_ps(_mm256_set1_ps(m.m13), z)), _mm256_set1_ps(m.m14));
+		__m256 cy = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m.m21), x), _mm256_mul_ps(_mm256_set1_ps(m.m22), y)), _mm256_mul_ps(_mm256_set1_ps(m.m23), z)), _mm256_set1_ps(m.m24));
+		__m256 cz = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m.m31), x), _mm256_mul_ps(_mm256_set1_ps(m.m32), y)), _mm256_mul_ps(_mm256_set1_ps(m.m33), z)), _mm256_set1_ps(m.m34));
+		__m256 cw = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m.m41), x), _mm256_mul_ps(_mm256_set1_ps(m.m42), y)), _mm256_mul_ps(_mm256_set1_ps(m.m43), z)), _mm256_set1_ps(m.m44));
+
+		__m256 inverseW = _mm256_div_ps(_mm256_set1_ps(1.0f), cw);
+		__m256 sx = _mm256_mul_ps(cx, inverseW);
+		__m256 sy = _mm256_mul_ps(cy, inverseW);
+		__m256 depth = _mm256_mul_ps(cz, inverseW);
+
+		__m256 guardBand = _mm256_set1_ps(GUARD_BAND);
+		__m256 negativeGuardBand = _mm256_set1_ps(-GUARD_BAND);
+		__m256 isInView = _mm256_and_ps(
+			_mm256_and_ps(_mm256_cmp_ps(cz, _mm256_setzero_ps(), _CMP_GE_OQ), _mm256_and_ps(_mm256_cmp_ps(sx, negativeGuardBand, _CMP_GE_OQ), _mm256_cmp_ps(sx, guardBand, _CMP_LE_OQ))),
+			_mm256_and_ps(_mm256_cmp_ps(sy, negativeGuardBand, _CMP_GE_OQ), _mm256_cmp_ps(sy, guardBand, _CMP_LE_OQ))
+		);
+
+		depth = _mm256_blendv_ps(_mm256_set1_ps(-1.0f), depth, isInView);
+
+		_mm256_storeu_ps(outX, sx);
+		_mm256_storeu_ps(outY, sy);
+		_mm256_storeu_ps(outZ, depth);
+		_mm256_storeu_ps(outInverseW, inverseW);
+	}
+	#endif
+
+	/**
+	 * Runs a SIMD kernel over a stream in batches of its lane count.
+	 * The final partial batch is padded through temporary storage,
+	 * so that every vertex is projected by the same kernel.
+	 */
+	template<int LANES, typename Batch>
+	void projectBatches(Batch projectBatch, const ProjectionParameters& p, const float* inX, const float* inY, const float* inZ, float* outX, float* outY, float* outZ, float* outInverseW, int count) {
+		int i = 0;
+
+		for (; i + LANES <= count; i += LANES) {
+			projectBatch(p, inX + i, inY + i, inZ + i, outX + i, outY + i, outZ + i, outInverseW + i);
+		}
+
+		if (i < count) {
+			float padded[7][LANES] = {};
+			int remaining = count - i;
+
+			for (int j = 0; j < remaining; j++) {
+				padded[0][j] = inX[i + j];
+				padded[1][j] = inY[i + j];
+				padded[2][j] = inZ[i + j];
+			}
+
+			projectBatch(p, padded[0], padded[1], padded[2], padded[3], padded[4], padded[5], padded[6]);
+
+			for (int j = 0; j < remaining; j++) {
+				outX[i + j] = padded[3][j];
+				outY[i + j] = padded[4][j];
+				outZ[i + j] = padded[5][j];
+				outInverseW[i + j] = padded[6][j];
+			}
+		}
+	}
+}
+
+VertexProcessor::VertexProcessor() {
+	if (!setKernel(AVX2_KERNEL)) {
+		setKernel(SSE_KERNEL);
+	}
+}
+
+VertexKernel VertexProcessor::getKernel() {
+	return kernel;
+}
+
+const char* VertexProcessor::getKernelName() {
+	switch (kernel) {
+		case AVX2_KERNEL: return "AVX2";
+		case SSE_KERNEL: return "SSE";
+		default: return "Scalar";
+	}
+}
+
+bool VertexProcessor::isKernelSupported(VertexKernel kernel) {
+	switch (kernel) {
+		case SCALAR_KERNEL:
+			return true;
+		#ifdef HAS_X86_KERNELS
+		case SSE_KERNEL:
+			return __builtin_cpu_supports("sse2");
+		case AVX2_KERNEL:
+			return __builtin_cpu_supports("avx2");
+		#endif
+		default:
+			return false;
+	}
+}
+
+/**
+ * Divides a clip-space vertex by its w, e.g. one created by clipping,
+ * returning its screen coordinates and depth.
+ */
+Vec3 VertexProcessor::divide(const Vec4& vertex) {
+	float inverseW = 1.0f / vertex.w;
+
+	return { vertex.x * inverseW, vertex.y * inverseW, vertex.z * inverseW };
+}
+
+/**
+ * Projects the first count vertices of the input stream into the
+ * output stream, which is resized to hold exactly that many.
+ */
+void VertexProcessor::project(const ProjectionParameters& parameters, const VertexSpan& input, int count, VertexStream& output) {
+	output.resize(count);
+	output.inverseW.resize(count);
+
+	if (count == 0) {
+		return;
+	}
+
+	const float* inX = input.x;
+	const float* inY = input.y;
+	const float* inZ = input.z;
+	float* outX = output.x.data();
+	float* outY = output.y.data();
+	float* outZ = output.z.data();
+	float* outInverseW = output.inverseW.data();
+
+	switch (kernel) {
+		#ifdef HAS_X86_KERNELS
+		case AVX2_KERNEL:
+			projectBatches<8>(projectAVX8, parameters, inX, inY, inZ, outX, outY, outZ, outInverseW, count);
+			break;
+		case SSE_KERNEL:
+			projectBatches<4>(projectSSE4, parameters, inX, inY, inZ, outX, outY, outZ, outInverseW, count);
+			break;
+		#endif
+		default:
+			projectScalar(parameters, inX, inY, inZ, outX, outY, outZ, outInverseW, count);
+			break;
+	}
+}
+
+bool VertexProcessor::setKernel(VertexKernel kernel) {
+	if (!isKernelSupported(kernel)) {
+		return false;
+	}
+
+	this->kernel = kernel;
+
+	return true;
+}
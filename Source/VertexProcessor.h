@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include <Types.h>
+
+/**
+ * Implementations of the vertex projection stage. SIMD kernels are
+ * only available on x86 processors supporting them.
+ */
+enum VertexKernel {
+	SCALAR_KERNEL,
+	SSE_KERNEL,
+	AVX2_KERNEL
+};
+
+// Projected vertices further than this many pixels from the screen
+// origin are treated as outside of the view and clipped, keeping
+// sub-pixel coordinates well within SUBPIXEL_LIMIT
+constexpr static float GUARD_BAND = (SUBPIXEL_LIMIT >> SUBPIXEL_BITS) / 2;
+
+/**
+ * Parameters shared by every vertex projected in a batch. Vertices
+ * are carried from model space into clip space by the combined model,
+ * view and projection transform, then divided by their w.
+ */
+struct ProjectionParameters {
+	Matrix4 transform;
+};
+
+/**
+ * Transforms and projects streams of vertices, several at a time on
+ * processors with SIMD support. The fastest kernel supported by the
+ * processor is selected at runtime. In projected output streams, the
+ * x and y components are screen coordinates, z is the depth, and
+ * inverseW is the reciprocal of the clip-space w. The depth of
+ * vertices behind the near plane or outside of the guard band is
+ * negative, since they must be clipped before they can be drawn.
+ */
+class VertexProcessor {
+	public:
+		VertexProcessor();
+		VertexKernel getKernel();
+		const char* getKernelName();
+		bool setKernel(VertexKernel kernel);
+		void project(const ProjectionParameters& parameters, const VertexSpan& input, int count, VertexStream& output);
+		static bool isKernelSupported(VertexKernel kernel);
+		static Vec3 divide(const Vec4& vertex);
+	private:
+		VertexKernel kernel = SCALAR_KERNEL;
+};
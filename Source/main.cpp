@@ -1,34 +1,261 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <MeshFile.h>
 #include <Objects.h>
 #include <Engine.h>
+#include <Profiler.h>
+#include <Random.h>
+#include <Recording.h>
+#include <Terrain.h>
+#include <Texture.h>
 
 int width = 1200;
 int height = 720;
+constexpr float MODEL_RADIUS = 200.0f;
+
+/**
+ * Loads a model from either an OBJ file or a binary mesh file,
+ * depending on its extension.
+ */
+std::shared_ptr<const MeshResource> loadModel(const char* path) {
+	const char* extension = strrchr(path, '.');
+
+	if (extension != NULL && strcmp(extension, ".obj") == 0) {
+		return MeshFile::importObj(path);
+	}
+
+	return MeshFile::load(path);
+}
 
 int main(int argc, char* argv[]) {
-	Engine engine(width, height);
+	// Usage: softengine [--headless <frames>] [--dump <path.png|path.ppm>] [--binned] [--half-space] [--pipelined]
+	//   [--depth16] [--direct] [--wireframe] [--wireframe-depth] [--cull <none|back|front>]
+	//   [--trace <path.json>] [--profile-csv <path.csv>] [--seed <seed>] [--record <path>] [--replay <path>]
+	//   [--model <path.obj|path.mesh>] [--texture <path.ppm>] [--depth-prepass] [--sort-triangles] [--flat] [--textured]
+	//   softengine --convert <input.obj> <output.mesh>
+	int headlessFrames = 0;
+	const char* dumpPath = NULL;
+	const char* tracePath = NULL;
+	const char* csvPath = NULL;
+	const char* recordPath = NULL;
+	const char* replayPath = NULL;
+	const char* modelPath = NULL;
+	const char* texturePath = NULL;
+	bool isTextured = false;
+	uint32_t seed = Random::DEFAULT_SEED;
+	Uint32 flags = 0;
+	CullMode cullMode = CULL_BACK;
+
+	if (argc == 4 && strcmp(argv[1], "--convert") == 0) {
+		std::shared_ptr<MeshResource> mesh = MeshFile::importObj(argv[2]);
+
+		if (mesh == NULL) {
+			printf("Unable to import %s\n", argv[2]);
+			return 1;
+		}
+
+		if (!MeshFile::save(*mesh, argv[3])) {
+			printf("Unable to save mesh to %s\n", argv[3]);
+			return 1;
+		}
+
+		printf("Converted %d vertices and %d polygons\n", mesh->getVertexCount(), mesh->getIndices().size / 3);
+		return 0;
+	}
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--binned") == 0) {
+			flags |= BINNED_RASTERIZATION;
+		} else if (strcmp(argv[i], "--half-space") == 0) {
+			flags |= HALF_SPACE_RASTERIZATION;
+		} else if (strcmp(argv[i], "--pipelined") == 0) {
+			flags |= PIPELINED_PRESENTATION;
+		} else if (strcmp(argv[i], "--depth16") == 0) {
+			flags |= COMPACT_DEPTH;
+		} else if (strcmp(argv[i], "--direct") == 0) {
+			flags |= DIRECT_PRESENTATION;
+		} else if (strcmp(argv[i], "--wireframe") == 0) {
+			flags |= SHOW_WIREFRAME;
+		} else if (strcmp(argv[i], "--wireframe-depth") == 0) {
+			flags |= SHOW_WIREFRAME | DEPTH_TESTED_WIREFRAME;
+		} else if (strcmp(argv[i], "--depth-prepass") == 0) {
+			flags |= DEPTH_PREPASS;
+		} else if (strcmp(argv[i], "--sort-triangles") == 0) {
+			flags |= SORTED_TRIANGLES;
+		} else if (strcmp(argv[i], "--flat") == 0) {
+			flags |= FLAT_SHADING;
+		} else if (strcmp(argv[i], "--textured") == 0) {
+			isTextured = true;
+		} else if (i == argc - 1) {
+			break;
+		} else if (strcmp(argv[i], "--headless") == 0) {
+			headlessFrames = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "--dump") == 0) {
+			dumpPath = argv[++i];
+		} else if (strcmp(argv[i], "--trace") == 0) {
+			tracePath = argv[++i];
+		} else if (strcmp(argv[i], "--profile-csv") == 0) {
+			csvPath = argv[++i];
+		} else if (strcmp(argv[i], "--seed") == 0) {
+			seed = strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "--record") == 0) {
+			recordPath = argv[++i];
+		} else if (strcmp(argv[i], "--replay") == 0) {
+			replayPath = argv[++i];
+		} else if (strcmp(argv[i], "--model") == 0) {
+			modelPath = argv[++i];
+		} else if (strcmp(argv[i], "--texture") == 0) {
+			texturePath = argv[++i];
+		} else if (strcmp(argv[i], "--cull") == 0) {
+			const char* mode = argv[++i];
+
+			cullMode = strcmp(mode, "none") == 0 ? CULL_NONE : strcmp(mode, "front") == 0 ? CULL_FRONT : CULL_BACK;
+		}
+	}
+
+	if (texturePath != NULL && modelPath == NULL) {
+		printf("--texture is applied to the model, so requires --model\n");
+		return 1;
+	}
+
+	Recording recording;
+
+	if (replayPath != NULL) {
+		if (!recording.load(replayPath)) {
+			printf("Unable to load recording from %s\n", replayPath);
+			return 1;
+		}
+
+		// Replays rebuild the recorded scene, and are always headless
+		// so that they measure rendering alone
+		seed = recording.seed;
+		width = recording.width;
+		height = recording.height;
+		flags |= HEADLESS;
+	}
+
+	if (headlessFrames > 0) {
+		flags |= HEADLESS;
+	}
+
+	if ((tracePath != NULL || csvPath != NULL) && !Profiler::isEnabled()) {
+		printf("Profiling was compiled out; only frame times will be recorded\n");
+	}
+
+	if (tracePath != NULL) {
+		Profiler::startTrace();
+	}
+
+	if (csvPath != NULL && !Profiler::openCsv(csvPath)) {
+		printf("Unable to write profile to %s\n", csvPath);
+		return 1;
+	}
+
+	Engine engine(width, height, flags);
 
-	Mesh mesh(100, 40, 50);
+	engine.setCullMode(cullMode);
 
-	mesh.position = { -1000, 0, -1000 };
-	mesh.setColor(0, 255, 0);
+	Random::seed(seed);
 
-	Cube cube(100);
-	Cube cube2(50);
-	Cube cube3(25);
+	Terrain terrain(112, 48, 50);
 
-	cube.position = { -200, 200, 500 };
-	cube2.position = { 50, 150, 500 };
-	cube3.position = { 200, 100, 500 };
+	terrain.setPosition({ -1000, 0, -1000 });
+
+	// Textured cubes are checkered, which shows off both perspective
+	// correction and mip levels
+	std::shared_ptr<const Texture> checkerboard = isTextured ? Texture::createCheckerboard(256, 8, { 240, 240, 240 }, { 40, 90, 160 }) : NULL;
+
+	Cube cube(100, checkerboard);
+	Cube cube2(50, checkerboard);
+	Cube cube3(25, checkerboard);
+
+	cube.setPosition({ -200, 200, 500 });
+	cube2.setPosition({ 50, 150, 500 });
+	cube3.setPosition({ 200, 100, 500 });
 
 	cube.rotate({ 0.5, 0.5, 0.5 });
 	cube2.rotate({ 1, 1.5, 0.7 });
 	cube3.rotate({ -0.5, 0.8, -0.3 });
 
-	engine.addObject(&mesh);
+	engine.addTerrain(&terrain);
 	engine.addObject(&cube);
 	engine.addObject(&cube2);
 	engine.addObject(&cube3);
-	engine.run();
+
+	Object model;
+
+	if (modelPath != NULL) {
+		Uint64 startTime = SDL_GetPerformanceCounter();
+		std::shared_ptr<const MeshResource> mesh = loadModel(modelPath);
+
+		if (mesh == NULL) {
+			printf("Unable to load model from %s\n", modelPath);
+			return 1;
+		}
+
+		printf(
+			"Loaded %d vertices and %d polygons from %s in %.2fms\n",
+			mesh->getVertexCount(),
+			mesh->getIndices().size / 3,
+			modelPath,
+			(SDL_GetPerformanceCounter() - startTime) * 1000.0 / SDL_GetPerformanceFrequency()
+		);
+
+		// Fit the model into a sphere in front of the camera, whatever
+		// units it was modeled in
+		const BoundingBox& bounds = mesh->getBounds();
+		Vec3 center = (bounds.min + bounds.max) * 0.5f;
+		Vec3 extent = bounds.max - bounds.min;
+		float radius = std::max(extent.magnitude() * 0.5f, 0.0001f);
+		float scale = MODEL_RADIUS / radius;
+
+		model.setMesh(mesh);
+		model.setScale(scale);
+		model.setTexture(isTextured ? checkerboard : NULL);
+		model.setPosition(Vec3 { 0, 150, 600 } - center * scale);
+
+		engine.addObject(&model);
+	}
+
+	if (texturePath != NULL) {
+		std::shared_ptr<const Texture> texture = Texture::load(texturePath);
+
+		if (texture == NULL) {
+			printf("Unable to load texture from %s\n", texturePath);
+			return 1;
+		}
+
+		model.setTexture(texture);
+	}
+
+	if (recordPath != NULL && replayPath == NULL) {
+		engine.record(&recording);
+	}
+
+	if (replayPath != NULL) {
+		engine.replay(recording);
+	} else if (headlessFrames > 0) {
+		engine.run(headlessFrames);
+	} else {
+		engine.run();
+	}
+
+	if (dumpPath != NULL && (flags & HEADLESS) && !engine.saveFrame(dumpPath)) {
+		printf("Unable to save frame to %s\n", dumpPath);
+		return 1;
+	}
+
+	if (recordPath != NULL && replayPath == NULL && !recording.save(recordPath)) {
+		printf("Unable to save recording to %s\n", recordPath);
+		return 1;
+	}
+
+	if (tracePath != NULL && !Profiler::writeTrace(tracePath)) {
+		printf("Unable to save trace to %s\n", tracePath);
+		return 1;
+	}
 
 	return 0;
 }
\ No newline at end of file